@@ -0,0 +1,51 @@
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <cstring>
+
+#include "cxxopts.hpp"
+
+#include "exp.h"
+#include "exp_event_log.h"
+
+using std::cout;
+using std::endl;
+
+// Renders a binary event log of surface as its text output
+int main(int argc, char* argv[]) {
+    cxxopts::Options options(argv[0], "Event Log Viewer");
+    options.add_options()
+        ("f,file", "Event log file", cxxopts::value<std::string>())
+        ("l,level", "Only events up to this level (0: cycles, 1: rounds, 2: layers), -1: all in the file", cxxopts::value<int>()->default_value("-1"))
+        ("h,help", "Print usage");
+    options.parse_positional({"file"});
+
+    auto result = options.parse(argc, argv);
+
+    if (result.count("help") || !result.count("file")) {
+        cout << options.help() << endl;
+        return 0;
+    }
+
+    auto file_name = result["file"].as<std::string>();
+    int level = result["level"].as<int>();
+
+    auto fin = safe_open_r(file_name, std::ios::binary);
+
+    EventLogHeader h;
+    fin.read((char*)&h, sizeof(h));
+    Assert_msg(fin && std::memcmp(h.magic, EventLogHeader::MAGIC, sizeof(h.magic)) == 0, file_name << " is not an event log");
+    Assert_msg(h.version == EventLogHeader::VERSION, "Unsupported event log version " << h.version);
+
+    EventText text{h.n_qubits, h.syndrome_len};
+
+    Event e;
+    std::size_t n = 0;
+    while (fin.read((char*)&e, sizeof(e))) {
+        if (level < 0 || Event::level_of(e.type) <= level) text.render(cout, e);
+        ++n;
+    }
+    cout << endl << n << " events (level " << h.level << ")" << endl;
+
+    return 0;
+}
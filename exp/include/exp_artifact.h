@@ -0,0 +1,116 @@
+#ifndef _EXP_ARTIFACT_H
+#define _EXP_ARTIFACT_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <unordered_map>
+#include <cstdint>
+#include <type_traits>
+
+#include "op/sop.h"
+#include "base/assertion.h"
+
+#include "exp_io.h"
+
+// Name of an artifact: <kind>.<64-bit FNV-1a of the inputs it is built from>
+class ArtifactKey {
+public:
+    explicit ArtifactKey(std::string kind) : kind(std::move(kind)) {}
+
+    template<typename T>
+    ArtifactKey& add(const T& x) {
+        static_assert(std::is_trivially_copyable<T>::value, "Only plain values");
+        add_bytes(&x, sizeof(T));
+        return *this;
+    }
+
+    template<typename T>
+    ArtifactKey& add(const std::vector<T>& x) {
+        static_assert(std::is_trivially_copyable<T>::value, "Only plain values");
+        add<std::uint64_t>(x.size());
+        add_bytes(x.data(), x.size() * sizeof(T));
+        return *this;
+    }
+
+    std::string str() const;
+
+private:
+    std::string kind;
+    std::uint64_t h = 14695981039346656037ULL;
+
+    void add_bytes(const void* p, std::size_t n);
+};
+
+// Immutable sparse operators in one file, mapped read-only: every process of a node shares its pages
+// (and the cache lines) instead of holding a private copy
+// Compile: get() builds every op and keeps it for write(), run with the file afterwards
+class ArtifactStore {
+public:
+    // Maps file_name if it exists (not when compiling)
+    ArtifactStore(const std::string& file_name, bool compile);
+
+    // No Copy
+    ArtifactStore(const ArtifactStore&) = delete;
+    ArtifactStore& operator=(const ArtifactStore&) = delete;
+
+    // A view of the op of key (dim x dim) in the file, build() if it is not there
+    SOp get(const std::string& key, sz_t dim, const std::function<SOp()>& build);
+
+    // Atomically replaces the file with the ops built by get()
+    void write();
+
+    const std::string& file() const { return file_name; }
+    bool is_mapped() const { return mapped != nullptr; }
+    // Ops got from the file / built (private) so far
+    std::size_t n_shared() const { return n_views; }
+    std::size_t n_private() const { return n_built; }
+
+private:
+    class Entry {
+    public:
+        char key[48];
+        std::uint32_t symmetric;
+        std::uint32_t triangular;
+        std::uint8_t hermitian;
+        std::uint8_t diagonal;
+        std::uint8_t _pad[6];
+        std::uint64_t n_rows;
+        std::uint64_t n_cols;
+        std::uint64_t nnz;
+        // From the start of the file
+        std::uint64_t values;
+        std::uint64_t columns;
+        std::uint64_t rows;
+    };
+
+    class Header {
+    public:
+        char magic[8];
+        std::uint32_t byte_order; // ENDIAN_MARK as the writer stores it, the arrays are in its native order
+        std::uint32_t version;
+        std::uint32_t int_size; // sizeof(MKL_INT) of the writer
+        std::uint32_t _pad;
+        std::uint64_t n_entries;
+    };
+
+    static const char MAGIC[8];
+    static constexpr std::uint32_t ENDIAN_MARK = 0x01020304;
+    static constexpr std::uint32_t VERSION = 2;
+    static constexpr std::size_t ALIGN = 64; // Arrays start at cache lines
+
+    std::string file_name;
+    bool compile;
+
+    std::unique_ptr<MappedFile> mapped;
+    std::unordered_map<std::string, const Entry*> entries;
+
+    // Kept for write()
+    std::vector<std::pair<std::string, SOp>> built;
+
+    std::size_t n_views = 0;
+    std::size_t n_built = 0;
+};
+
+#endif // _EXP_ARTIFACT_H
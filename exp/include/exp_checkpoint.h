@@ -0,0 +1,122 @@
+#ifndef _EXP_CHECKPOINT_H
+#define _EXP_CHECKPOINT_H
+
+#include <string>
+#include <vector>
+#include <sstream>
+#include <limits>
+#include <cstring>
+#include <cstdint>
+#include <type_traits>
+
+#include "state/state.h"
+#include "base/assertion.h"
+
+// Binary checkpoint of a run: a header, then the values in the order they were put (no names)
+// Written to <file>.tmp, fsync'ed and renamed over <file>, so <file> is always a complete checkpoint
+class CheckpointWriter {
+public:
+    CheckpointWriter();
+
+    template<typename T>
+    void put(const T& x) {
+        static_assert(std::is_trivially_copyable<T>::value, "put_text() for non-trivial types");
+        buf.append(reinterpret_cast<const char*>(&x), sizeof(T));
+    }
+
+    void put(const std::string& x) {
+        put<std::uint64_t>(x.size());
+        buf.append(x);
+    }
+
+    template<typename T>
+    void put(const std::vector<T>& x) {
+        put<std::uint64_t>(x.size());
+        for (auto& e : x) put(e);
+    }
+
+    // Amplitudes and block occupancy
+    void put(const State& s);
+
+    // Through the stream operator (RandomEngine, std distributions, Welford, ...), doubles exactly
+    template<typename T>
+    void put_text(const T& x) {
+        std::ostringstream out;
+        out.precision(std::numeric_limits<double>::max_digits10);
+        out << x;
+        put(out.str());
+    }
+
+    // Atomically replaces file_name
+    void commit(const std::string& file_name) const;
+
+private:
+    std::string buf;
+};
+
+class CheckpointReader {
+public:
+    explicit CheckpointReader(const std::string& file_name);
+
+    static bool exists(const std::string& file_name);
+
+    template<typename T>
+    void get(T& x) {
+        static_assert(std::is_trivially_copyable<T>::value, "get_text() for non-trivial types");
+        Assert_msg(pos + sizeof(T) <= buf.size(), "Truncated checkpoint " << file_name);
+        std::memcpy(&x, buf.data() + pos, sizeof(T));
+        pos += sizeof(T);
+    }
+
+    void get(std::string& x) {
+        std::uint64_t n;
+        get(n);
+        Assert_msg(pos + n <= buf.size(), "Truncated checkpoint " << file_name);
+        x.assign(buf.data() + pos, n);
+        pos += n;
+    }
+
+    template<typename T>
+    void get(std::vector<T>& x) {
+        std::uint64_t n;
+        get(n);
+        x.resize(n);
+        for (auto& e : x) get(e);
+    }
+
+    // Into s of the same dims (and block size if tracked)
+    void get(State& s);
+
+    template<typename T>
+    void get_text(T& x) {
+        std::string text;
+        get(text);
+        std::istringstream in{text};
+        in >> x;
+        Assert_msg(!in.fail(), "Corrupted checkpoint " << file_name);
+    }
+
+    template<typename T>
+    T get() {
+        T x;
+        get(x);
+        return x;
+    }
+
+private:
+    std::string file_name;
+    std::string buf;
+    std::size_t pos = 0;
+};
+
+class CheckpointHeader {
+public:
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t _pad;
+
+    static const char MAGIC[8];
+    static constexpr std::uint32_t VERSION = 1;
+};
+
+#endif // _EXP_CHECKPOINT_H
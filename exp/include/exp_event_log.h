@@ -0,0 +1,165 @@
+#ifndef _EXP_EVENT_LOG_H
+#define _EXP_EVENT_LOG_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <ostream>
+#include <fstream>
+#include <atomic>
+#include <thread>
+
+#include "base/assertion.h"
+
+// Typed records of a surface code run, qubit masks: qubit q <-> 1 << (n_qubits - 1 - q)
+// indent: depth of the text rendering (the perfect check is nested in the cycle)
+class Event {
+public:
+    enum class Type : std::uint8_t {
+        Trajectory,     // m1: trajectory
+        Cycle,          // a: cycle, m1: syndrome weight so far (splitting)
+        Round,          // a: round, m1: #layers
+        Layer,          // a: layer
+        Jump,           // a: 0 amplitude damping / 1 dephasing, m1: qubit
+        MeasureBegin,   // x: duration
+        Measure,        // m1: X results, m2: Z results
+        Flip,           // a: 0 X / 1 Z, m1: flipped, m2: results after the flips
+        RoundDone,      // a: round, x: ms
+        CorrectBegin,   // a: 0 X / 1 Z
+        Syndrome,       // m1: packed syndrome
+        Correction,     // a: 0 none / 1 X (m1: x, m2: id) / 2 Z (m1: z)
+        CorrectionDone,
+        DetectBegin,
+        Check,          // x: fidelity with the initial state, y: with the logical error
+        NoLogicalError,
+        LogicalError,   // a: cycle
+        FailureBegin,   // Logical error probability of a state (analytic check)
+        Outcome,        // m1: ancilla results, x: probability
+        FailureDone,    // x: P(logical error), y: dropped probability
+        SplittingClone, // a: stage, m1: repeat, m2: clone
+        SplittingStage, // a: stage, m1: repeat, x: fraction reaching the next level, y: fraction failed
+    };
+
+    Type type;
+    std::uint8_t indent = 0;
+    std::uint16_t _pad = 0;
+    std::uint32_t a = 0;
+    std::uint64_t m1 = 0;
+    std::uint64_t m2 = 0;
+    double x = 0.;
+    double y = 0.;
+
+    // Verbosity: 0 cycles and logical errors, 1 + rounds, measurements and corrections, 2 + layers and jumps
+    static int level_of(Type type) {
+        switch (type) {
+            case Type::Layer:
+            case Type::Jump:
+                return 2;
+            case Type::Trajectory:
+            case Type::Cycle:
+            case Type::Check:
+            case Type::NoLogicalError:
+            case Type::LogicalError:
+            case Type::FailureBegin:
+            case Type::FailureDone:
+            case Type::SplittingClone:
+            case Type::SplittingStage:
+                return 0;
+            default:
+                return 1;
+        }
+    }
+};
+
+// Start of an event log file, followed by Events
+class EventLogHeader {
+public:
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t n_qubits;
+    std::uint32_t syndrome_len; // Bits per round of a packed syndrome
+    std::uint32_t level;
+
+    static const char MAGIC[8];
+    static constexpr std::uint32_t VERSION = 2;
+};
+
+// Renders events in the text format of the surface driver
+class EventText {
+public:
+    EventText(std::uint32_t n_qubits, std::uint32_t syndrome_len) : n_qubits(n_qubits), syndrome_len(syndrome_len) {}
+
+    void render(std::ostream& out, const Event& e);
+
+private:
+    std::uint32_t n_qubits;
+    std::uint32_t syndrome_len;
+
+    void output_mask(std::ostream& out, std::uint64_t mask);
+    void output_qubits(std::ostream& out, std::uint64_t mask, const char* sep, bool descending);
+};
+
+// Events of one process
+// Binary: events go into a single producer / single consumer ring, a background thread writes them to the file
+// Text: rendered to the stream right away (the former output)
+class EventLog {
+public:
+    // Text
+    EventLog(std::ostream& out, std::uint32_t n_qubits, std::uint32_t syndrome_len, int level = 2);
+    // Binary, capacity: #events in the ring (a power of 2)
+    // append: continue an existing file of the same header (a resumed run), a torn last event is dropped
+    EventLog(const std::string& file_name, std::uint32_t n_qubits, std::uint32_t syndrome_len, int level = 2, std::size_t capacity = 1 << 16, bool append = false);
+    ~EventLog();
+
+    // No Copy
+    EventLog(const EventLog&) = delete;
+    EventLog& operator=(const EventLog&) = delete;
+
+    bool wants(Event::Type type) const { return Event::level_of(type) <= level; }
+
+    // Events above the level are dropped, a full ring waits for the writer
+    void emit(const Event& e) {
+        if (!wants(e.type)) return;
+
+        if (text_out) {
+            text.render(*text_out, e);
+            return;
+        }
+
+        std::size_t t = tail.load(std::memory_order_relaxed);
+        while (t - head.load(std::memory_order_acquire) == ring.size()) {
+            ++n_stalls;
+            std::this_thread::yield();
+        }
+        ring[t & (ring.size() - 1)] = e;
+        tail.store(t + 1, std::memory_order_release);
+    }
+
+    void emit(Event::Type type, std::uint32_t a = 0, std::uint64_t m1 = 0, std::uint64_t m2 = 0, double x = 0., double y = 0., std::uint8_t indent = 0) {
+        Event e;
+        e.type = type; e.indent = indent;
+        e.a = a; e.m1 = m1; e.m2 = m2; e.x = x; e.y = y;
+        emit(e);
+    }
+
+    bool is_binary() const { return text_out == nullptr; }
+    // Times the producer found the ring full
+    std::size_t stalls() const { return n_stalls; }
+
+private:
+    int level;
+    EventText text;
+    std::ostream* text_out = nullptr;
+
+    std::vector<Event> ring;
+    std::atomic<std::size_t> head{0}; // Next to write
+    std::atomic<std::size_t> tail{0}; // Next to fill
+    std::size_t n_stalls = 0;
+
+    std::ofstream fout;
+    std::atomic<bool> stopping{false};
+    std::thread writer;
+    void write_loop();
+};
+
+#endif // _EXP_EVENT_LOG_H
@@ -3,6 +3,9 @@
 
 #include <vector>
 #include <fstream>
+#include <string>
+#include <cstddef>
+#include <utility>
 
 #include "exp_types.h"
 #include "base/assertion.h"
@@ -19,6 +22,32 @@ inline std::ofstream safe_open_w(const std::string& file_name, std::ios::openmod
     return f;
 }
 
+// Read-only memory map of a whole file, the pages are shared with every process mapping it
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& file_name);
+    ~MappedFile();
+
+    // No Copy
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Move
+    MappedFile(MappedFile&& other) noexcept : addr(other.addr), len(other.len) { other.addr = nullptr; other.len = 0; }
+    MappedFile& operator=(MappedFile&& other) noexcept {
+        std::swap(addr, other.addr);
+        std::swap(len, other.len);
+        return *this;
+    }
+
+    const char* data() const { return static_cast<const char*>(addr); }
+    std::size_t size() const { return len; }
+
+private:
+    void* addr = nullptr;
+    std::size_t len = 0;
+};
+
 dm_t load_dm(const char* fname);
 
 std::vector<double> load_vec(const char* fname);
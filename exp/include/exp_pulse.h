@@ -1,7 +1,11 @@
 #ifndef _EXP_PULSE_H
 #define _EXP_PULSE_H
 
+#include <vector>
+#include <functional>
+
 #include "base/types.h"
+#include "base/assertion.h"
 
 template<typename T> T pow2(T x) { return x * x; }
 
@@ -68,4 +72,38 @@ public:
     const double beta;
 };
 
+// Piecewise Chebyshev interpolants of several envelopes on [0, T], sharing the pieces
+// One evaluation computes the basis once for all the envelopes (channels)
+// breaks: where the envelopes may have kinks, no piece straddles one
+class PulseTable {
+public:
+    static constexpr sz_t MAX_DEGREE = 31;
+
+    PulseTable() = default;
+    PulseTable(double T, const std::vector<std::function<double(double)>>& fs, sz_t n_pieces, sz_t degree, std::vector<double> breaks = {});
+
+    sz_t n_channels() const { return n_ch; }
+    bool empty() const { return n_ch == 0; }
+
+    // out[c] = fs[c](t), t is clamped to [0, T]
+    void eval(double t, double* out) const;
+
+    double eval(double t) const {
+        Assert(n_ch == 1);
+        double out;
+        eval(t, &out);
+        return out;
+    }
+
+    // max |table - f| of every channel on n_samples equidistant points
+    std::vector<double> max_error(const std::vector<std::function<double(double)>>& fs, sz_t n_samples = 10007) const;
+
+private:
+    double T = 0;
+    sz_t n_ch = 0;
+    sz_t degree = 0;
+    std::vector<double> edges;  // [#pieces + 1]
+    std::vector<double> coeffs; // [piece][channel][degree + 1]
+};
+
 #endif // _EXP_PULSE_H
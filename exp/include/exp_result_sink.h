@@ -0,0 +1,76 @@
+#ifndef _EXP_RESULT_SINK_H
+#define _EXP_RESULT_SINK_H
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <functional>
+
+#include "nlohmann/json.hpp"
+#include "base/assertion.h"
+
+// Append-only results of one process, JSON lines in segments <base>.<k>.jsonl
+// A segment starts with {"header": ..., "segment": k}, followed by one record per line
+// Every record is written right away (kept if the process dies), fsync'ed in batches of sync_records / sync_seconds
+// The segment being written is <base>.<k>.jsonl.part, renamed when it is full (segment_bytes) or the sink is closed
+class ResultSink {
+public:
+    class Options {
+    public:
+        std::size_t sync_records = 64;
+        double sync_seconds = 10.;
+        std::size_t segment_bytes = std::size_t(64) << 20;
+    };
+
+    ResultSink(const std::string& base, nlohmann::json header, Options opt);
+    ResultSink(const std::string& base, nlohmann::json header) : ResultSink(base, std::move(header), Options{}) {}
+    ~ResultSink();
+
+    // No Copy
+    ResultSink(const ResultSink&) = delete;
+    ResultSink& operator=(const ResultSink&) = delete;
+
+    // The record gets its number "seq" (0, 1, ... in this run)
+    void append(const nlohmann::json& record);
+
+    // A run resumed from a checkpoint continues the numbering (and the "run" of the header)
+    std::size_t n_records() const { return seq; }
+    void set_n_records(std::size_t n) { seq = n; }
+
+    // fsync the records written so far
+    void sync();
+
+    static std::string segment_name(const std::string& base, std::size_t k);
+
+private:
+    std::string base;
+    nlohmann::json header;
+    Options opt;
+
+    int fd = -1;
+    std::size_t segment = 0;
+    std::size_t segment_size = 0;
+
+    std::size_t seq = 0;
+
+    std::size_t n_unsynced = 0;
+    std::chrono::steady_clock::time_point last_sync;
+
+    void open_segment();
+    void close_segment();
+    void write_line(const std::string& line);
+};
+
+// Segments of ResultSinks, complete or not
+class ResultReader {
+public:
+    // Segment files of base, in order (the last one may be a .part)
+    static std::vector<std::string> segments(const std::string& base);
+
+    // Calls on_record(header, record) for every record of the segments of base
+    // A torn last line (a process killed while writing) is skipped, so are the records a resumed run wrote again
+    // (the same "run" in the header and a "seq" seen before)
+    static void read(const std::string& base, const std::function<void(const nlohmann::json& header, const nlohmann::json& record)>& on_record);
+};
+
+#endif // _EXP_RESULT_SINK_H
@@ -1,6 +1,9 @@
 #ifndef _EXP_STATE_H
 #define _EXP_STATE_H
 
+#include <vector>
+#include <string>
+
 #include "exp_types.h"
 #include "state/state.h"
 
@@ -17,11 +20,27 @@ double trace_distance(const dm_t& A, const dm_t& B);
 
 double dm_fidelity(const dm_t& A, const dm_t& B);
 
+// Streaming, without the full density matrix
+
+// Reduced density matrix of freedoms frees (frees[0] most significant), one pass
+dm_t reduced_dm(const State& s, const std::vector<sz_t>& frees);
+
+inline double reduced_trace_distance(const State& a, const State& b, const std::vector<sz_t>& frees) {
+    return trace_distance(reduced_dm(a, frees), reduced_dm(b, frees));
+}
+
+inline double reduced_fidelity(const State& a, const State& b, const std::vector<sz_t>& frees) {
+    return dm_fidelity(reduced_dm(a, frees), reduced_dm(b, frees));
+}
+
+// <P> for a batch of Pauli strings ("IXYZ" per qubit, qubit 0 first), one pass over a qubit state
+std::vector<double> pauli_expectations(const State& s, const std::vector<std::string>& paulis);
+
 template<typename Container>
 inline sz_t bit_rep(sz_t n_qubits, const Container& qubits) {
     sz_t b = 0;
     for (auto q : qubits)
-        b |= (1 << (n_qubits - 1 - i));
+        b |= (1 << (n_qubits - 1 - q));
     return b;
 }
 
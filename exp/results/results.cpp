@@ -0,0 +1,109 @@
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <numeric>
+#include <cmath>
+#include <algorithm>
+#include <map>
+
+#include "nlohmann/json.hpp"
+#include "cxxopts.hpp"
+
+#include "qe.h"
+#include "exp.h"
+#include "exp_result_sink.h"
+
+using std::cout;
+using std::endl;
+
+using nlohmann::json;
+
+// Merges the result segments (ResultSink) of many surface processes into one estimate
+int main(int argc, char* argv[]) {
+    cxxopts::Options options(argv[0], "Merge Results");
+    options.add_options()
+        ("i,input", "Result bases (<base>.<k>.jsonl)", cxxopts::value<std::vector<std::string>>())
+        ("l,level", "Confidence level", cxxopts::value<double>()->default_value("0.95"))
+        ("o,output", "Merged result output file", cxxopts::value<std::string>()->default_value("merged.json"))
+        ("h,help", "Print usage");
+    options.parse_positional({"input"});
+
+    auto result = options.parse(argc, argv);
+
+    if (result.count("help") || !result.count("input")) {
+        cout << options.help() << endl;
+        return 0;
+    }
+
+    auto bases = result["input"].as<std::vector<std::string>>();
+    double level = result["level"].as<double>();
+
+    json merged;
+    merged["headers"] = json::array();
+    merged["cycles"] = json::array();
+
+    // Sampled logical errors: #cycles of a run is the one of its last estimate
+    // (a resumed run continues its count, a new run on the same base starts again from 0)
+    std::size_t n_failures = 0, n_cycles = 0;
+    std::map<std::string, std::size_t> run_cycles;
+    // Analytic check: expected failures and cycles per trajectory
+    std::vector<double> fails, cycles;
+    // Splitting: P(logical error in n_cycles) per repeat
+    Welford p_fail;
+    std::size_t splitting_cycles = 0;
+
+    for (auto& base : bases) {
+        ResultReader::read(base, [&](const json& header, const json& r) {
+            // Headers without a run id: one run per base
+            auto run = base + "/" + (header.count("run") ? header["run"].dump() : std::string());
+            if (!run_cycles.count(run)) {
+                merged["headers"].push_back(header);
+                run_cycles[run] = 0;
+            }
+
+            auto type = r["type"].get<std::string>();
+            if (type == "failure") {
+                ++n_failures;
+                merged["cycles"].push_back(r["cycle"]);
+
+            } else if (type == "estimate") {
+                if (r.count("n_cycles")) run_cycles[run] = r["n_cycles"].get<std::size_t>();
+
+            } else if (type == "analytic") {
+                fails.push_back(1. - r["survival"].get<double>());
+                cycles.push_back(r["mean_cycles"].get<double>());
+
+            } else if (type == "splitting") {
+                p_fail.add(r["p_fail"].get<double>());
+                splitting_cycles = r["n_cycles"].get<std::size_t>();
+            }
+        });
+
+        cout << base << ": " << ResultReader::segments(base).size() << " segments" << endl;
+    }
+
+    for (auto& rc : run_cycles) n_cycles += rc.second;
+
+    if (n_cycles) {
+        double p = (double)n_failures / n_cycles;
+        Interval ci = wilson_interval(n_failures, n_cycles, level);
+        merged["estimate"] = {{"p_cycle", p}, {"ci", {ci.lo, ci.hi}}, {"n_failures", n_failures}, {"n_cycles", n_cycles}};
+    } else if (!fails.empty()) {
+        double p = std::accumulate(fails.begin(), fails.end(), 0.) / std::accumulate(cycles.begin(), cycles.end(), 0.);
+        Interval ci = ratio_interval(fails, cycles, level);
+        merged["estimate"] = {{"method", "analytic"}, {"p_cycle", p}, {"ci", {ci.lo, ci.hi}}, {"n_trajectories", fails.size()}};
+    } else if (p_fail.count()) {
+        Interval ci = p_fail.interval(level);
+        double p_cycle = 1 - std::pow(1 - p_fail.mean(), 1. / splitting_cycles);
+        merged["estimate"] = {{"p_fail", p_fail.mean()}, {"ci", {ci.lo, ci.hi}}, {"p_cycle", p_cycle}, {"n_repeats", p_fail.count()}};
+    }
+
+    if (merged.count("estimate")) cout << "Estimate: " << merged["estimate"] << endl;
+    else cout << "No estimate" << endl;
+
+    std::ofstream fout{result["output"].as<std::string>()};
+    fout << merged;
+
+    return 0;
+}
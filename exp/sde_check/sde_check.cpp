@@ -0,0 +1,127 @@
+// Strong convergence of PlatenSolver against a known solution
+//  dy0 = dxi, dy1 = y0^* dxi
+//  y0(T) = xi(T), y1(T) = 1/2 (|xi(T)|^2 - T) + i A(T), A: Levy area of (W1, W2), xi = (W1 + i W2) / sqrt(2)
+// The noise is not commutative (b_1 is not holomorphic), as for QSD
+
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include <cstdlib>
+
+#include "qe.h"
+
+using namespace std;
+
+constexpr double T = 1.0;
+constexpr sz_t N_FINE = 1 << 16; // Pieces of the reference path
+constexpr sz_t N_PATHS = 400;
+constexpr sz_t MIN_STEPS = 4;
+constexpr sz_t N_LEVELS = 5;     // h = T / MIN_STEPS ... T / (MIN_STEPS 2^(N_LEVELS - 1))
+
+class AreaSDE : public SDE {
+public:
+    void drift(State& dy, const State& y, double t) override { dy = 0.; }
+
+    std::size_t n_noises() const override { return 1; }
+    void diffusion(State& dy, const State& y, double t, std::size_t k) override {
+        dy[0] = 1.;
+        dy[1] = std::conj(y[0]);
+    }
+};
+
+// Declared commutative, so the Levy areas are dropped
+class DroppedAreaSDE : public AreaSDE {
+public:
+    bool commutative_noise() const override { return true; }
+};
+
+// Steps along a given fine path instead of drawing one
+class PathPlatenSolver : public PlatenSolver {
+public:
+    PathPlatenSolver(StatePool& pool, CNormalRand& rnd, const std::vector<Complex>& path)
+        : PlatenSolver(pool, rnd), path(path) {}
+
+    void rewind() { pos = 0; }
+
+protected:
+    void draw(Segment& seg, std::size_t n_noises, double h) override {
+        sz_t n = n_pieces(h);
+        sz_t n_fine = sz_t(std::round(h / T * N_FINE));
+        Assert(n_noises == 1 && n_fine % n == 0 && pos + n_fine <= path.size());
+
+        seg.h = h;
+        seg.dt.assign(n, h / n);
+        seg.dxi.assign(n, 0.);
+        for (sz_t i = 0; i < n_fine; ++i) seg.dxi[i / (n_fine / n)] += path[pos + i];
+        pos += n_fine;
+    }
+
+private:
+    const std::vector<Complex>& path;
+    sz_t pos = 0;
+};
+
+// Mean |y_h(T) - y(T)| for each level
+std::vector<double> strong_errors(SDE* sde) {
+    CNormalRand rnd{20200101};
+    StatePool pool;
+
+    std::vector<Complex> path(N_FINE);
+    PathPlatenSolver solver{pool, rnd, path};
+
+    std::vector<double> err(N_LEVELS, 0.);
+    for (sz_t p = 0; p < N_PATHS; ++p) {
+        double sqrt_dt = std::sqrt(T / N_FINE);
+        for (auto& x : path) x = sqrt_dt * rnd();
+
+        // Exact solution
+        Complex xi = 0.;
+        double area = 0.;
+        for (const auto& d : path) {
+            // 1/2 (W1 dW2 - W2 dW1), W = sqrt(2) (Re, Im)
+            area += xi.real() * d.imag() - xi.imag() * d.real();
+            xi += d;
+        }
+        Complex y1 = Complex(0.5 * (std::norm(xi) - T), area);
+
+        for (sz_t l = 0; l < N_LEVELS; ++l) {
+            State y{std::vector<sz_t>{2}};
+            y = 0.;
+
+            solver.rewind();
+            solver.set_step_size(T / (MIN_STEPS << l));
+            solver.solve(sde, y, 0., T);
+
+            err[l] += std::sqrt(std::norm(y[0] - xi) + std::norm(y[1] - y1)) / N_PATHS;
+        }
+    }
+
+    return err;
+}
+
+// Fitted order of convergence
+double report(const char* name, const std::vector<double>& err) {
+    cout << name << endl;
+    for (sz_t l = 0; l < N_LEVELS; ++l)
+        cout << "  h = 1/" << setw(4) << left << (MIN_STEPS << l) << "  err = " << err[l] << endl;
+
+    double order = std::log2(err.front() / err.back()) / (N_LEVELS - 1);
+    cout << "  order = " << order << endl;
+    return order;
+}
+
+int main(int argc, char* argv[]) {
+    blas_init(1);
+
+    AreaSDE full;
+    DroppedAreaSDE dropped;
+
+    double order = report("Levy areas", strong_errors(&full));
+    report("Levy areas dropped", strong_errors(&dropped));
+
+    if (order < PlatenSolver::ORDER - 0.2) {
+        cout << "Strong order " << order << " < " << PlatenSolver::ORDER << endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
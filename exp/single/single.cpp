@@ -1,6 +1,8 @@
 #include <string>
 #include <iostream>
 #include <fstream>
+#include <limits>
+#include <cmath>
 
 #include "nlohmann/json.hpp"
 #include "cxxopts.hpp"
@@ -20,6 +22,18 @@ public:
     }
 };
 
+class SingleWorker : public EnsembleWorker {
+public:
+    SingleWorker(std::size_t id, seed_t seed, Op* H, const std::vector<Op*>& L, const std::vector<Op*>& Ldag, const std::string& solver_type)
+        : EnsembleWorker(id, seed), unr(H, L, Ldag, pool, eng) {
+        if (solver_type == "rk45") solver.reset(new RK45Solver(pool));
+        else solver.reset(new ZVODESolver(pool));
+    }
+
+    Jump unr;
+    std::unique_ptr<ODESolver> solver;
+};
+
 void dump_result(const std::string& result_file, json& results) {
     std::ofstream fout{result_file};
     fout << results;
@@ -32,7 +46,12 @@ int main(int argc, char* argv[]) {
         ("t2", "T2", cxxopts::value<double>()->default_value("0"))
         ("i,init", "Init state type (0, 1, +, -)", cxxopts::value<char>()->default_value("1"))
         ("j,jump", "Jump type to detect (Amp, Ph)", cxxopts::value<std::string>()->default_value("Amp"))
-        ("n,ntraj", "Total number of trajectories to run", cxxopts::value<unsigned int>()->default_value("1"))
+        ("n,ntraj", "Total (max.) number of trajectories to run", cxxopts::value<unsigned int>()->default_value("1"))
+        ("rel-ci", "Stop early when the 95% CI half-width of the mean is below this fraction of it (0: off)", cxxopts::value<double>()->default_value("0"))
+        ("time-budget", "Stop early after this many seconds (0: off)", cxxopts::value<double>()->default_value("0"))
+        ("master", "Also evolve the density matrix for this many cycles (0: off)", cxxopts::value<unsigned int>()->default_value("0"))
+        ("t,threads", "Number of threads (0: all cores)", cxxopts::value<unsigned int>()->default_value("1"))
+        ("s,solver", "ODE solver (zvode, rk45), zvode only with one thread", cxxopts::value<std::string>()->default_value("zvode"))
         ("o,output", "Result output file", cxxopts::value<std::string>()->default_value("single.json"))
         ("h,help", "Print usage");
 
@@ -48,8 +67,15 @@ int main(int argc, char* argv[]) {
     char init = result["init"].as<char>();
     std::string jump = result["jump"].as<std::string>();
     unsigned int ntraj = result["ntraj"].as<unsigned int>();
+    unsigned int nthreads = result["threads"].as<unsigned int>();
     std::string result_file = result["output"].as<std::string>();
-    auto seed = std::random_device()();
+    double rel_ci = result["rel-ci"].as<double>();
+    double time_budget = result["time-budget"].as<double>();
+    unsigned int master_cycles = result["master"].as<unsigned int>();
+    std::string solver_type = result["solver"].as<std::string>();
+    if (solver_type != "zvode" && solver_type != "rk45") Error("Unknown solver: " << solver_type);
+    std::random_device rd;
+    std::uint64_t seed = (static_cast<std::uint64_t>(rd()) << 32) | rd();
 
     json results;
     results["config"] = {
@@ -57,9 +83,12 @@ int main(int argc, char* argv[]) {
         {"T2", T2},
         {"init_state", std::string(1, init)},
         {"jump", jump},
-        {"seed", seed}
+        {"seed", seed},
+        {"rel_ci", rel_ci},
+        {"time_budget", time_budget},
+        {"master", master_cycles},
+        {"solver", solver_type}
     };
-    results["cycles"] = json::array();
 
     // Init
     State init_state{{2}, 0};
@@ -86,35 +115,78 @@ int main(int argc, char* argv[]) {
     int idx = 0;
     if (T1 != 0 && T2 != 0 && jump == "Ph") idx = 1;
 
-    // Run
     IdleOp idle;
-    StatePool pool;
-    std::mt19937 eng{seed};
-
-    Jump unr{&idle, L, Ldag, pool, eng};
-    ZVODESolver solver{pool};
-
-    for (unsigned int i = 0; i < ntraj; ++i) {
-        auto s_g = pool.allocate_similar(init_state);
-        auto& s = s_g.state;
-        s = init_state;
-        unr.new_trajectory();
-        
-        bool detected = false;
-        for (sz_t cycle = 0; !detected; ++cycle) {
-            unr.solve(&solver, s, 0, 1);
-            
-            for (auto& info : unr.jumps()) {
-                if (info.idx == idx) {
-                    double time = (double)cycle + info.time;
-                    results["cycles"].push_back(time);
-                    detected = true;
-                    break;
+
+    // Density matrix, as a reference for the trajectories
+    if (master_cycles) {
+        StatePool pool;
+        MasterEquation me{&idle, L, Ldag, pool};
+        ZVODESolver solver{pool};
+
+        State rho = MasterEquation::density_matrix(init_state);
+        json& m = results["master"];
+        for (unsigned int cycle = 0; cycle <= master_cycles; ++cycle) {
+            if (cycle) me.solve(&solver, rho, cycle - 1, cycle);
+            m["p1"].push_back(rho[3].real());
+            m["coherence"].push_back(std::abs(rho[1]));
+        }
+
+        cout << "Master: p1 = " << rho[3].real() << ", |rho01| = " << std::abs(rho[1]) << " after " << master_cycles << " cycles" << endl;
+    }
+
+    // Run
+    Ensemble ensemble{nthreads};
+    // ZVODE keeps its integrator state in COMMON blocks and SAVE locals, shared by every thread
+    Assert_msg(ensemble.n_workers() == 1 || solver_type != "zvode", "zvode is not reentrant, use --solver rk45 with " << ensemble.n_workers() << " threads");
+    std::vector<double> times(ntraj, std::numeric_limits<double>::quiet_NaN()); // NaN: not run
+    std::vector<char> merged(ntraj, 0); // In stats (finished before the stop)
+    Welford stats;
+    StopRule stop;
+    stop.set_rel_ci(rel_ci).set_time_budget(time_budget);
+
+    ensemble.run(ntraj,
+        [&](std::size_t w) {
+            return std::unique_ptr<SingleWorker>(new SingleWorker(w, seed, &idle, L, Ldag, solver_type));
+        },
+        [&](SingleWorker& wk, std::size_t i) {
+            auto s_g = wk.pool.allocate_similar(init_state);
+            auto& s = s_g.state;
+            s = init_state;
+            wk.unr.new_trajectory();
+
+            bool detected = false;
+            for (sz_t cycle = 0; !detected; ++cycle) {
+                wk.unr.solve(wk.solver.get(), s, 0, 1);
+
+                for (auto& info : wk.unr.jumps()) {
+                    if (info.idx == idx) {
+                        times[i] = (double)cycle + info.time;
+                        detected = true;
+                        break;
+                    }
                 }
             }
+        },
+        [&](std::size_t i) {
+            stats.add(times[i]);
+            merged[i] = 1;
+            return stop.should_stop(stats.count(), stats.mean(), stats.interval(stop.get_level()));
         }
+    );
+
+    results["cycles"] = json::array();
+    for (std::size_t i = 0; i < ntraj; ++i) {
+        if (merged[i]) results["cycles"].push_back(times[i]);
     }
 
+    Interval ci = stats.interval(stop.get_level());
+    results["mean"] = stats.mean();
+    results["ci"] = {ci.lo, ci.hi};
+
+    cout << "#Threads: " << ensemble.n_workers() << endl;
+    cout << "Mean: " << stats.mean() << " [" << ci.lo << ", " << ci.hi << "] (" << stats.count() << " trajectories)" << endl;
+    if (!stop.reason().empty()) cout << "Stopped early: " << stop.reason() << endl;
+
     dump_result(result_file, results);
 
     for (auto& l : L) delete l;
@@ -245,7 +245,7 @@ std::vector<Tout> generate(const std::vector<Tin>& in, Gen gen) {
 }
 
 void test_measure_1() {
-    std::mt19937 eng;
+    RandomEngine eng;
 
     State s1({2}, 0);
     s1[0] = 2;
@@ -306,7 +306,7 @@ void test_measure_1() {
 }
 
 void test_measure_2() {
-    std::mt19937 eng;
+    RandomEngine eng;
 
     State s1({2});
     s1[0] = 1;
@@ -406,7 +406,7 @@ void test_measure_2() {
 }
 
 void test_measure2_1() {
-    std::mt19937 eng;
+    RandomEngine eng;
 
     State s1({2}, 0);
     s1[0] = 2;
@@ -491,7 +491,7 @@ void test_measure2_1() {
 }
 
 void test_measure2_2() {
-    std::mt19937 eng;
+    RandomEngine eng;
 
     State s1({2});
     s1[0] = 1;
@@ -0,0 +1,170 @@
+#include "exp_artifact.h"
+
+#include <cstdio>
+#include <cerrno>
+#include <cstring>
+#include <limits>
+
+#include <unistd.h>
+
+const char ArtifactStore::MAGIC[8] = {'Q', 'E', 'A', 'R', 'T', 'I', 'F', 'C'};
+constexpr std::uint32_t ArtifactStore::ENDIAN_MARK;
+constexpr std::uint32_t ArtifactStore::VERSION;
+constexpr std::size_t ArtifactStore::ALIGN;
+
+/* ------------------------ ArtifactKey ------------------------ */
+
+void ArtifactKey::add_bytes(const void* p, std::size_t n) {
+    auto b = static_cast<const unsigned char*>(p);
+    for (std::size_t i = 0; i < n; ++i) {
+        h ^= b[i];
+        h *= 1099511628211ULL;
+    }
+}
+
+std::string ArtifactKey::str() const {
+    char buf[17];
+    std::snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(h));
+    return kind + "." + buf;
+}
+
+/* ------------------------ ArtifactKey. ------------------------ */
+
+/* ------------------------ ArtifactStore ------------------------ */
+
+ArtifactStore::ArtifactStore(const std::string& file_name, bool compile) : file_name(file_name), compile(compile) {
+    if (compile || ::access(file_name.c_str(), R_OK) != 0) return;
+
+    mapped.reset(new MappedFile(file_name));
+    const char* p = mapped->data();
+    std::size_t size = mapped->size();
+
+    Header h;
+    Assert_msg(size >= sizeof(h), "Truncated artifact file " << file_name);
+    std::memcpy(&h, p, sizeof(h));
+    Assert_msg(std::memcmp(h.magic, MAGIC, sizeof(h.magic)) == 0, file_name << " is not an artifact file");
+    Assert_msg(h.byte_order == ENDIAN_MARK, file_name << " is of another byte order");
+    Assert_msg(h.version == VERSION, "Unsupported artifact file version " << h.version);
+    Assert_msg(h.int_size == sizeof(MKL_INT), "Artifact file of " << h.int_size << "-byte indices, " << sizeof(MKL_INT) << " expected");
+    Assert_msg(h.n_entries <= (size - sizeof(h)) / sizeof(Entry), "Truncated artifact file " << file_name);
+
+    // n elements of elem_size bytes at offset, without overflow (the offset first)
+    auto fits = [size](std::uint64_t offset, std::uint64_t n, std::size_t elem_size) {
+        return offset % ALIGN == 0 && offset <= size && n <= (size - offset) / elem_size;
+    };
+
+    auto dir = reinterpret_cast<const Entry*>(p + sizeof(h));
+    for (std::uint64_t i = 0; i < h.n_entries; ++i) {
+        auto& e = dir[i];
+        Assert_msg(e.n_rows < std::numeric_limits<std::uint64_t>::max() &&
+                   fits(e.rows, e.n_rows + 1, sizeof(MKL_INT)) &&
+                   fits(e.values, e.nnz, sizeof(Complex)) &&
+                   fits(e.columns, e.nnz, sizeof(MKL_INT)), "Truncated artifact file " << file_name);
+        entries[std::string(e.key, strnlen(e.key, sizeof(e.key)))] = &e;
+    }
+}
+
+SOp ArtifactStore::get(const std::string& key, sz_t dim, const std::function<SOp()>& build) {
+    auto it = entries.find(key);
+    if (it != entries.end()) {
+        auto& e = *it->second;
+        Assert_msg(e.n_rows == dim && e.n_cols == dim, key << " of " << file_name << " is " << e.n_rows << " x " << e.n_cols << ", " << dim << " expected");
+
+        SOp::CSR csr;
+        csr.n_rows = e.n_rows;
+        csr.n_cols = e.n_cols;
+        csr.nnz = e.nnz;
+        csr.values = reinterpret_cast<const Complex*>(mapped->data() + e.values);
+        csr.columns = reinterpret_cast<const MKL_INT*>(mapped->data() + e.columns);
+        csr.rows = reinterpret_cast<const MKL_INT*>(mapped->data() + e.rows);
+
+        SOpProperty prop;
+        prop.symmetric = static_cast<Symmetric>(e.symmetric);
+        prop.triangular = static_cast<Triangular>(e.triangular);
+        prop.hermitian = e.hermitian;
+        prop.diagonal = e.diagonal;
+
+        ++n_views;
+        return SOp::view(csr, prop);
+    }
+
+    SOp op = build();
+    Assert(op.n_rows() == dim && op.n_cols() == dim);
+    ++n_built;
+    if (compile) {
+        Assert_msg(key.size() < sizeof(Entry::key), "Artifact key too long: " << key);
+        bool seen = false;
+        for (auto& b : built) seen = seen || b.first == key;
+        if (!seen) built.push_back({key, op});
+    }
+    return op;
+}
+
+void ArtifactStore::write() {
+    auto aligned = [](std::size_t n) { return (n + ALIGN - 1) / ALIGN * ALIGN; };
+
+    // Header, directory, then the arrays of every op
+    Header h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, MAGIC, sizeof(h.magic));
+    h.byte_order = ENDIAN_MARK;
+    h.version = VERSION;
+    h.int_size = sizeof(MKL_INT);
+    h.n_entries = built.size();
+
+    std::vector<Entry> dir(built.size());
+    std::vector<SOp::CSR> csrs;
+    std::size_t offset = aligned(sizeof(h) + dir.size() * sizeof(Entry));
+    for (std::size_t i = 0; i < built.size(); ++i) {
+        auto& e = dir[i];
+        auto& op = built[i].second;
+        auto csr = op.csr();
+        csrs.push_back(csr);
+
+        std::memset(&e, 0, sizeof(e));
+        std::memcpy(e.key, built[i].first.data(), built[i].first.size());
+        e.symmetric = static_cast<std::uint32_t>(op.property().symmetric);
+        e.triangular = static_cast<std::uint32_t>(op.property().triangular);
+        e.hermitian = op.property().hermitian;
+        e.diagonal = op.property().diagonal;
+        e.n_rows = csr.n_rows;
+        e.n_cols = csr.n_cols;
+        e.nnz = csr.nnz;
+        e.values = offset;  offset = aligned(offset + csr.nnz * sizeof(Complex));
+        e.columns = offset; offset = aligned(offset + csr.nnz * sizeof(MKL_INT));
+        e.rows = offset;    offset = aligned(offset + (csr.n_rows + 1) * sizeof(MKL_INT));
+    }
+
+    // Readers map the final name only, never a partial file
+    auto tmp = file_name + ".tmp";
+    {
+        auto fout = safe_open_w(tmp, std::ios::binary);
+        std::size_t pos = 0;
+        auto put = [&fout, &pos](const void* p, std::size_t n) {
+            fout.write(static_cast<const char*>(p), n);
+            pos += n;
+        };
+        auto pad_to = [&fout, &pos](std::size_t at) {
+            static const char zeros[ALIGN] = {};
+            Assert(at >= pos && at - pos < ALIGN);
+            fout.write(zeros, at - pos);
+            pos = at;
+        };
+
+        put(&h, sizeof(h));
+        put(dir.data(), dir.size() * sizeof(Entry));
+        for (std::size_t i = 0; i < dir.size(); ++i) {
+            auto& e = dir[i];
+            auto& csr = csrs[i];
+            pad_to(e.values);  put(csr.values, csr.nnz * sizeof(Complex));
+            pad_to(e.columns); put(csr.columns, csr.nnz * sizeof(MKL_INT));
+            pad_to(e.rows);    put(csr.rows, (csr.n_rows + 1) * sizeof(MKL_INT));
+        }
+        pad_to(offset);
+
+        Assert_msg(fout.good(), "Cannot write " << tmp);
+    }
+    Assert_msg(std::rename(tmp.c_str(), file_name.c_str()) == 0, "Cannot rename " << tmp << ": " << std::strerror(errno));
+}
+
+/* ------------------------ ArtifactStore. ------------------------ */
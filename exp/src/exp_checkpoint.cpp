@@ -0,0 +1,94 @@
+#include "exp_checkpoint.h"
+
+#include <cstdio>
+#include <cerrno>
+#include <fstream>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+const char CheckpointHeader::MAGIC[8] = {'Q', 'E', 'C', 'H', 'E', 'C', 'K', 'P'};
+constexpr std::uint32_t CheckpointHeader::VERSION;
+
+/* ------------------------ CheckpointWriter ------------------------ */
+
+CheckpointWriter::CheckpointWriter() {
+    CheckpointHeader h;
+    std::memcpy(h.magic, CheckpointHeader::MAGIC, sizeof(h.magic));
+    h.version = CheckpointHeader::VERSION;
+    h._pad = 0;
+    put(h);
+}
+
+void CheckpointWriter::put(const State& s) {
+    put<std::uint64_t>(s.total_dims());
+    buf.append(reinterpret_cast<const char*>(s.data()), sizeof(Complex) * s.total_dims());
+
+    std::vector<std::uint8_t> occupied;
+    if (s.tracks_blocks()) {
+        for (sz_t b = 0; b < s.n_blocks(); ++b) occupied.push_back(s.block_occupied(b));
+    }
+    put<std::uint64_t>(s.block_size());
+    put(occupied);
+}
+
+void CheckpointWriter::commit(const std::string& file_name) const {
+    auto tmp = file_name + ".tmp";
+
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    Assert_msg(fd >= 0, "Cannot open " << tmp << ": " << std::strerror(errno));
+
+    const char* p = buf.data();
+    std::size_t n = buf.size();
+    while (n) {
+        ssize_t w = ::write(fd, p, n);
+        if (w < 0 && errno == EINTR) continue;
+        Assert_msg(w > 0, "Cannot write checkpoint: " << std::strerror(errno));
+        p += w;
+        n -= w;
+    }
+    Assert_msg(::fsync(fd) == 0, "Cannot sync " << tmp << ": " << std::strerror(errno));
+    ::close(fd);
+
+    Assert_msg(std::rename(tmp.c_str(), file_name.c_str()) == 0, "Cannot rename " << tmp << ": " << std::strerror(errno));
+}
+
+/* ------------------------ CheckpointWriter. ------------------------ */
+
+/* ------------------------ CheckpointReader ------------------------ */
+
+CheckpointReader::CheckpointReader(const std::string& file_name) : file_name(file_name) {
+    std::ifstream fin{file_name, std::ios::binary};
+    Assert_msg(fin.is_open(), file_name << " not exists.");
+    buf.assign(std::istreambuf_iterator<char>(fin), std::istreambuf_iterator<char>());
+
+    CheckpointHeader h;
+    Assert_msg(buf.size() >= sizeof(h), file_name << " is not a checkpoint");
+    get(h);
+    Assert_msg(std::memcmp(h.magic, CheckpointHeader::MAGIC, sizeof(h.magic)) == 0, file_name << " is not a checkpoint");
+    Assert_msg(h.version == CheckpointHeader::VERSION, "Unsupported checkpoint version " << h.version);
+}
+
+bool CheckpointReader::exists(const std::string& file_name) {
+    return ::access(file_name.c_str(), F_OK) == 0;
+}
+
+void CheckpointReader::get(State& s) {
+    std::uint64_t n = get<std::uint64_t>();
+    Assert_msg(n == s.total_dims(), "Checkpoint state has " << n << " amplitudes, expected " << s.total_dims());
+    Assert_msg(pos + sizeof(Complex) * n <= buf.size(), "Truncated checkpoint " << file_name);
+    std::memcpy(s.data(), buf.data() + pos, sizeof(Complex) * n);
+    pos += sizeof(Complex) * n;
+
+    std::uint64_t block_size = get<std::uint64_t>();
+    std::vector<std::uint8_t> occupied;
+    get(occupied);
+    if (occupied.empty()) {
+        s.mark_all_blocks();
+    } else {
+        Assert_msg(s.tracks_blocks() && s.block_size() == block_size && s.n_blocks() == occupied.size(), "Checkpoint state has other blocks");
+        for (sz_t b = 0; b < occupied.size(); ++b) s.set_block_occupied(b, occupied[b]);
+    }
+}
+
+/* ------------------------ CheckpointReader. ------------------------ */
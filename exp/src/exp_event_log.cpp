@@ -0,0 +1,225 @@
+#include "exp_event_log.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cerrno>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "exp_io.h"
+
+const char EventLogHeader::MAGIC[8] = {'Q', 'E', 'E', 'V', 'E', 'N', 'T', 'S'};
+constexpr std::uint32_t EventLogHeader::VERSION;
+
+/* ------------------------ EventText ------------------------ */
+
+void EventText::output_mask(std::ostream& out, std::uint64_t mask) {
+    for (std::uint32_t q = 0; q < n_qubits; ++q) out << ((mask >> (n_qubits - 1 - q)) & 1 ? '1' : '0');
+}
+
+void EventText::output_qubits(std::ostream& out, std::uint64_t mask, const char* sep, bool descending) {
+    bool first = true;
+    for (std::uint32_t i = 0; i < n_qubits; ++i) {
+        std::uint32_t q = descending ? n_qubits - 1 - i : i;
+        if (!((mask >> (n_qubits - 1 - q)) & 1)) continue;
+        if (!first) out << sep;
+        out << q;
+        first = false;
+    }
+}
+
+void EventText::render(std::ostream& out, const Event& e) {
+    std::string indent(e.indent, ' ');
+    auto list = [this, &out](std::uint64_t mask, bool descending) {
+        out << "[";
+        output_qubits(out, mask, ", ", descending);
+        out << "]";
+    };
+
+    using T = Event::Type;
+    switch (e.type) {
+        case T::Trajectory:
+            out << "Trajectory " << e.m1 << ":" << '\n';
+            break;
+
+        case T::Cycle:
+            out << "Cycle " << e.a;
+            if (e.m1) out << " (weight " << e.m1 << ")";
+            out << ":" << '\n';
+            break;
+
+        case T::Round:
+            out << "  Syndrome Extraction " << e.a << ":" << '\n';
+            out << "    Layer(" << e.m1 << "): ";
+            break;
+
+        case T::Layer:
+            out << e.a << ' ';
+            break;
+
+        case T::Jump:
+            out << (e.a == 0 ? "Amp(" : "Ph(") << e.m1 << ") ";
+            break;
+
+        case T::MeasureBegin:
+            out << "\n    Measure(T = " << e.x << "): ";
+            break;
+
+        case T::Measure:
+            out << '\n';
+            out << "      X: "; output_mask(out, e.m1); out << '\n';
+            out << "      Z: "; output_mask(out, e.m2); out << '\n';
+            break;
+
+        case T::Flip:
+            if (e.a == 0) out << "    Flip:" << '\n';
+            out << (e.a == 0 ? "      X: " : "      Z: "); output_qubits(out, e.m1, " ", false); out << '\n';
+            out << "         "; output_mask(out, e.m2); out << '\n';
+            break;
+
+        case T::RoundDone:
+            out << "  Syndrome Extraction " << e.a << ": " << e.x << " ms" << '\n';
+            break;
+
+        case T::CorrectBegin:
+            out << indent << (e.a == 0 ? "Correct X:" : "Correct Z:") << '\n';
+            break;
+
+        case T::Syndrome: {
+            out << indent << "Syndrome: ";
+            std::uint32_t n_rounds = 64 / syndrome_len;
+            for (std::uint32_t r = n_rounds; r-- > 0;) {
+                std::uint64_t bits = e.m1 >> (r * syndrome_len);
+                for (std::uint32_t i = syndrome_len; i-- > 0;) out << ((bits >> i) & 1);
+                if (r) out << ' ';
+            }
+            out << '\n';
+            break;
+        }
+
+        case T::Correction:
+            if (e.a == 0) {
+                out << indent << "Correction: None" << '\n';
+                break;
+            }
+            out << indent << "Correction: " << '\n';
+            out << indent << "  Type: " << (e.a == 2 ? "Z" : "X") << '\n';
+            out << indent << "   X: "; list(e.a == 1 ? e.m1 : 0, true); out << '\n';
+            out << indent << "   id: "; list(e.a == 1 ? e.m2 : 0, true); out << '\n';
+            out << indent << "   Z: "; list(e.a == 2 ? e.m1 : 0, false); out << '\n';
+            out << indent << "  Jumps: ";
+            break;
+
+        case T::CorrectionDone:
+            out << '\n';
+            break;
+
+        case T::DetectBegin:
+            out << "  Detect Logical Error:" << '\n';
+            break;
+
+        case T::Check:
+            out << indent << "Check:" << '\n';
+            out << indent << "  Fidelity (none vs error): " << e.x << " " << e.y << '\n';
+            break;
+
+        case T::NoLogicalError:
+            out << "      Logical Error: None" << '\n';
+            break;
+
+        case T::LogicalError:
+            out << "      Logical Error Detected at Cycle " << e.a << '\n';
+            break;
+
+        case T::FailureBegin:
+            out << "  Logical Error Probability:" << '\n';
+            break;
+
+        case T::Outcome:
+            out << "    Outcome "; output_mask(out, e.m1); out << " (p = " << e.x << "):" << '\n';
+            break;
+
+        case T::FailureDone:
+            out << "    P(Logical Error): " << e.x << " (dropped " << e.y << ")" << '\n';
+            break;
+
+        case T::SplittingClone:
+            out << "Splitting " << e.m1 << ", stage " << e.a << ", trajectory " << e.m2 << ":" << '\n';
+            break;
+
+        case T::SplittingStage:
+            out << "Splitting " << e.m1 << ", stage " << e.a << ": reached " << e.x << ", failed " << e.y << '\n';
+            break;
+    }
+}
+
+/* ------------------------ EventText. ------------------------ */
+
+/* ------------------------ EventLog ------------------------ */
+
+EventLog::EventLog(std::ostream& out, std::uint32_t n_qubits, std::uint32_t syndrome_len, int level)
+    : level(level), text(n_qubits, syndrome_len), text_out(&out) {}
+
+EventLog::EventLog(const std::string& file_name, std::uint32_t n_qubits, std::uint32_t syndrome_len, int level, std::size_t capacity, bool append)
+    : level(level), text(n_qubits, syndrome_len), ring(capacity) {
+    Assert_msg(capacity && (capacity & (capacity - 1)) == 0, "Capacity must be a power of 2: " << capacity);
+
+    EventLogHeader h;
+    std::memcpy(h.magic, EventLogHeader::MAGIC, sizeof(h.magic));
+    h.version = EventLogHeader::VERSION;
+    h.n_qubits = n_qubits;
+    h.syndrome_len = syndrome_len;
+    h.level = level;
+
+    struct stat st;
+    if (append && ::stat(file_name.c_str(), &st) == 0 && (std::size_t)st.st_size >= sizeof(h)) {
+        EventLogHeader old;
+        safe_open_r(file_name, std::ios::binary).read((char*)&old, sizeof(old));
+        Assert_msg(std::memcmp(&old, &h, sizeof(h)) == 0, file_name << " is an event log of another run");
+
+        // Whole events only
+        std::size_t n = (st.st_size - sizeof(h)) / sizeof(Event);
+        Assert_msg(::truncate(file_name.c_str(), sizeof(h) + n * sizeof(Event)) == 0, "Cannot truncate " << file_name << ": " << std::strerror(errno));
+        fout = safe_open_w(file_name, std::ios::binary | std::ios::app);
+    } else {
+        fout = safe_open_w(file_name, std::ios::binary);
+        fout.write((const char*)&h, sizeof(h));
+    }
+
+    writer = std::thread(&EventLog::write_loop, this);
+}
+
+EventLog::~EventLog() {
+    if (!writer.joinable()) return;
+
+    stopping.store(true, std::memory_order_release);
+    writer.join();
+    fout.flush();
+}
+
+void EventLog::write_loop() {
+    while (true) {
+        std::size_t h = head.load(std::memory_order_relaxed);
+        std::size_t t = tail.load(std::memory_order_acquire);
+
+        if (h == t) {
+            if (stopping.load(std::memory_order_acquire) && h == tail.load(std::memory_order_acquire)) break;
+            fout.flush();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+
+        // At most two contiguous pieces of the ring
+        while (h != t) {
+            std::size_t begin = h & (ring.size() - 1);
+            std::size_t n = std::min(t - h, ring.size() - begin);
+            fout.write((const char*)&ring[begin], n * sizeof(Event));
+            h += n;
+        }
+        head.store(h, std::memory_order_release);
+    }
+}
+
+/* ------------------------ EventLog. ------------------------ */
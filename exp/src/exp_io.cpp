@@ -1,5 +1,29 @@
 #include "exp_io.h"
 
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+MappedFile::MappedFile(const std::string& file_name) {
+    int fd = open(file_name.c_str(), O_RDONLY);
+    Assert_msg(fd >= 0, file_name << " not exists.");
+
+    struct stat st;
+    Assert(fstat(fd, &st) == 0);
+    len = st.st_size;
+
+    if (len) {
+        addr = mmap(nullptr, len, PROT_READ, MAP_SHARED, fd, 0);
+        Assert_msg(addr != MAP_FAILED, "Cannot map " << file_name);
+    }
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (addr) munmap(addr, len);
+}
+
 dm_t load_dm(const char* fname) {
     auto fin = safe_open_r(fname, std::ios::binary);
 
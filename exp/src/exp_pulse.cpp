@@ -0,0 +1,77 @@
+#include "exp_pulse.h"
+
+#include <cmath>
+#include <algorithm>
+
+constexpr sz_t PulseTable::MAX_DEGREE;
+
+PulseTable::PulseTable(double T, const std::vector<std::function<double(double)>>& fs, sz_t n_pieces, sz_t degree, std::vector<double> breaks)
+    : T(T), n_ch(fs.size()), degree(degree) {
+    Assert(T > 0 && n_pieces > 0);
+    Assert_msg(degree <= MAX_DEGREE, "Pulse table degree " << degree << " > " << MAX_DEGREE);
+
+    // Edges: the equidistant ones and the breaks
+    for (sz_t i = 0; i <= n_pieces; ++i) edges.push_back(T * i / n_pieces);
+    for (auto b : breaks) if (b > 0 && b < T) edges.push_back(b);
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end(), [T](double a, double b) { return b - a < 1e-12 * T; }), edges.end());
+    edges.back() = T;
+
+    // Interpolation at the Chebyshev nodes of every piece
+    sz_t n = degree + 1;
+    std::vector<double> f(n);
+    coeffs.resize((edges.size() - 1) * n_ch * n);
+    for (sz_t p = 0; p + 1 < edges.size(); ++p) {
+        double a = edges[p], b = edges[p + 1];
+
+        for (sz_t c = 0; c < n_ch; ++c) {
+            for (sz_t j = 0; j < n; ++j) {
+                double x = cos(M_PI * (j + 0.5) / n);
+                f[j] = fs[c](0.5 * (a + b) + 0.5 * (b - a) * x);
+            }
+
+            double* coeff = &coeffs[(p * n_ch + c) * n];
+            for (sz_t k = 0; k < n; ++k) {
+                double sum = 0;
+                for (sz_t j = 0; j < n; ++j) sum += f[j] * cos(M_PI * k * (j + 0.5) / n);
+                coeff[k] = sum * (k ? 2. : 1.) / n;
+            }
+        }
+    }
+}
+
+void PulseTable::eval(double t, double* out) const {
+    if (t <= 0) t = 0;
+    if (t >= T) t = T;
+
+    // Piece
+    sz_t p = std::upper_bound(edges.begin() + 1, edges.end() - 1, t) - edges.begin() - 1;
+    double a = edges[p], b = edges[p + 1];
+    double x = (2 * t - a - b) / (b - a);
+
+    // T_k(x), shared by the channels
+    double basis[MAX_DEGREE + 1];
+    basis[0] = 1;
+    if (degree) basis[1] = x;
+    for (sz_t k = 2; k <= degree; ++k) basis[k] = 2 * x * basis[k - 1] - basis[k - 2];
+
+    sz_t n = degree + 1;
+    const double* coeff = &coeffs[p * n_ch * n];
+    for (sz_t c = 0; c < n_ch; ++c, coeff += n) {
+        double sum = 0;
+        for (sz_t k = 0; k < n; ++k) sum += coeff[k] * basis[k];
+        out[c] = sum;
+    }
+}
+
+std::vector<double> PulseTable::max_error(const std::vector<std::function<double(double)>>& fs, sz_t n_samples) const {
+    Assert(fs.size() == n_ch && n_samples > 1);
+
+    std::vector<double> err(n_ch, 0.), out(n_ch);
+    for (sz_t i = 0; i < n_samples; ++i) {
+        double t = T * i / (n_samples - 1);
+        eval(t, out.data());
+        for (sz_t c = 0; c < n_ch; ++c) err[c] = std::max(err[c], std::abs(out[c] - fs[c](t)));
+    }
+    return err;
+}
@@ -0,0 +1,164 @@
+#include "exp_result_sink.h"
+
+#include <cstdio>
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+#include <fstream>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+
+/* ------------------------ ResultSink ------------------------ */
+
+std::string ResultSink::segment_name(const std::string& base, std::size_t k) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), ".%04zu.jsonl", k);
+    return base + buf;
+}
+
+ResultSink::ResultSink(const std::string& base, nlohmann::json header, Options opt)
+    : base(base), header(std::move(header)), opt(opt) {
+    Assert(opt.segment_bytes > 0);
+
+    // Continue after the segments of an earlier run of the same base, never overwrite one
+    segment = ResultReader::segments(base).size();
+    while (::access(segment_name(base, segment).c_str(), F_OK) == 0 || ::access((segment_name(base, segment) + ".part").c_str(), F_OK) == 0) ++segment;
+    open_segment();
+}
+
+ResultSink::~ResultSink() {
+    close_segment();
+}
+
+void ResultSink::open_segment() {
+    auto part = segment_name(base, segment) + ".part";
+    fd = ::open(part.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    Assert_msg(fd >= 0, "Cannot open " << part << ": " << std::strerror(errno));
+
+    segment_size = 0;
+    write_line(nlohmann::json{{"header", header}, {"segment", segment}}.dump());
+    sync();
+}
+
+void ResultSink::close_segment() {
+    if (fd < 0) return;
+
+    sync();
+    ::close(fd);
+    fd = -1;
+
+    // Complete segments appear atomically under their final name
+    auto name = segment_name(base, segment);
+    Assert_msg(std::rename((name + ".part").c_str(), name.c_str()) == 0, "Cannot rename " << name << ".part: " << std::strerror(errno));
+}
+
+void ResultSink::write_line(const std::string& line) {
+    std::string buf = line + '\n';
+
+    const char* p = buf.data();
+    std::size_t n = buf.size();
+    while (n) {
+        ssize_t w = ::write(fd, p, n);
+        if (w < 0 && errno == EINTR) continue;
+        Assert_msg(w > 0, "Cannot write results: " << std::strerror(errno));
+        p += w;
+        n -= w;
+    }
+
+    segment_size += buf.size();
+    ++n_unsynced;
+}
+
+void ResultSink::append(const nlohmann::json& record) {
+    nlohmann::json r = record;
+    r["seq"] = seq++;
+    write_line(r.dump());
+
+    if (n_unsynced >= opt.sync_records ||
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - last_sync).count() >= opt.sync_seconds) {
+        sync();
+    }
+
+    if (segment_size >= opt.segment_bytes) {
+        close_segment();
+        ++segment;
+        open_segment();
+    }
+}
+
+void ResultSink::sync() {
+    if (fd >= 0) ::fsync(fd);
+    n_unsynced = 0;
+    last_sync = std::chrono::steady_clock::now();
+}
+
+/* ------------------------ ResultSink. ------------------------ */
+
+/* ------------------------ ResultReader ------------------------ */
+
+std::vector<std::string> ResultReader::segments(const std::string& base) {
+    auto slash = base.find_last_of('/');
+    std::string dir = (slash == std::string::npos) ? "." : base.substr(0, slash);
+    std::string prefix = (slash == std::string::npos) ? base : base.substr(slash + 1);
+    if (dir.empty()) dir = "/";
+
+    // <prefix>.<k>.jsonl[.part]
+    std::vector<std::pair<std::size_t, std::string>> found;
+    DIR* d = opendir(dir.c_str());
+    if (!d) return {};
+    while (auto entry = readdir(d)) {
+        std::string name = entry->d_name;
+        if (name.compare(0, prefix.size() + 1, prefix + ".") != 0) continue;
+
+        std::size_t k;
+        char rest[16] = {};
+        if (std::sscanf(name.c_str() + prefix.size(), ".%zu.jsonl%15s", &k, rest) < 1) continue;
+        if (name != ResultSink::segment_name(prefix, k) && name != ResultSink::segment_name(prefix, k) + ".part") continue;
+
+        found.push_back({k, (slash == std::string::npos) ? name : dir + "/" + name});
+    }
+    closedir(d);
+
+    std::sort(found.begin(), found.end());
+    std::vector<std::string> ret;
+    for (auto& f : found) ret.push_back(f.second);
+    return ret;
+}
+
+void ResultReader::read(const std::string& base, const std::function<void(const nlohmann::json& header, const nlohmann::json& record)>& on_record) {
+    // Next new seq of every run
+    std::unordered_map<std::string, std::size_t> next_seq;
+
+    for (auto& file_name : segments(base)) {
+        std::ifstream fin{file_name};
+        Assert_msg(fin.is_open(), file_name << " not exists.");
+
+        nlohmann::json header;
+        std::string line;
+        bool first = true;
+        while (std::getline(fin, line)) {
+            // A line without its newline was torn by a crash
+            if (fin.eof()) break;
+
+            auto j = nlohmann::json::parse(line);
+            if (first) {
+                Assert_msg(j.count("header"), file_name << " has no header");
+                header = j["header"];
+                first = false;
+            } else {
+                if (header.count("run") && j.count("seq")) {
+                    auto& next = next_seq[header["run"].dump()];
+                    std::size_t seq = j["seq"].get<std::size_t>();
+                    if (seq < next) continue;
+                    next = seq + 1;
+                }
+                on_record(header, j);
+            }
+        }
+    }
+}
+
+/* ------------------------ ResultReader. ------------------------ */
@@ -1,6 +1,9 @@
 #include "exp_state.h"
 
+#include <algorithm>
+
 #include "base/assertion.h"
+#include "op/pauli.h"
 
 static dm_t sqrt_dm(const dm_t& dm) {
     Assert(dm.rows() == dm.columns());
@@ -29,3 +32,67 @@ double dm_fidelity(const dm_t& A, const dm_t& B) {
     auto sqrt_A = sqrt_dm(A);
     return sum(sqrt(abs(eigen(sqrt_A * B * sqrt_A))));
 }
+
+dm_t reduced_dm(const State& s, const std::vector<sz_t>& frees) {
+    // Offsets of the kept outcomes
+    std::vector<sz_t> offsets{0};
+    for (auto idx : frees) {
+        Assert(idx < s.n_freedoms());
+        std::vector<sz_t> next;
+        for (auto o : offsets) {
+            for (sz_t v = 0; v < s.dim(idx); ++v) next.push_back(o + v * s.skip(idx));
+        }
+        offsets = std::move(next);
+    }
+    sz_t d = offsets.size();
+
+    // The traced out freedoms, odometer over their values
+    std::vector<sz_t> rest;
+    for (sz_t i = 0; i < s.n_freedoms(); ++i) {
+        if (std::find(frees.begin(), frees.end(), i) == frees.end()) rest.push_back(i);
+    }
+    std::vector<sz_t> values(rest.size(), 0);
+
+    dm_t rho(d, d, Complex{0.});
+    ket_t v(d);
+    for (sz_t base = 0;;) {
+        // rho += v v^, v: the kept amplitudes at this value of the rest
+        for (sz_t a = 0; a < d; ++a) v[a] = s[base + offsets[a]];
+        for (sz_t a = 0; a < d; ++a) {
+            if (v[a] == 0.) continue;
+            for (sz_t b = 0; b < d; ++b) rho(a, b) += v[a] * std::conj(v[b]);
+        }
+
+        // Next value of the rest
+        std::size_t j = rest.size();
+        while (j-- > 0) {
+            sz_t idx = rest[j];
+            if (++values[j] < s.dim(idx)) {
+                base += s.skip(idx);
+                break;
+            }
+            base -= (values[j] - 1) * s.skip(idx);
+            values[j] = 0;
+        }
+        if (j == std::size_t(-1)) break;
+    }
+
+    return rho;
+}
+
+std::vector<double> pauli_expectations(const State& s, const std::vector<std::string>& paulis) {
+    for (sz_t i = 0; i < s.n_freedoms(); ++i) Assert(s.dim(i) == 2);
+
+    std::vector<PauliString> ps;
+    for (auto& str : paulis) {
+        Assert(str.size() == s.n_freedoms());
+        ps.emplace_back(str);
+    }
+
+    std::vector<const PauliString*> ptrs;
+    for (auto& p : ps) ptrs.push_back(&p);
+
+    std::vector<double> res;
+    PauliString::expectations(res, s, ptrs);
+    return res;
+}
@@ -2,17 +2,36 @@
 #include <iomanip>
 #include <string>
 #include <sstream>
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <memory>
+#include <chrono>
+#include <cstdio>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
 
 #include "nlohmann/json.hpp"
 #include "cxxopts.hpp"
 
 #include "qe.h"
 #include "exp.h"
+#include "exp_result_sink.h"
+#include "exp_checkpoint.h"
+#include "exp_artifact.h"
 
 #include "surface_sys.h"
 #include "surface_layer.h"
+#include "surface_schedule.h"
 #include "surface_decoder.h"
 #include "surface_circuit.h"
+#include "surface_run.h"
+#include "surface_splitting.h"
 
 using std::cout;
 using std::endl;
@@ -41,18 +60,104 @@ static std::vector<double> load_d_vec(json& config, sz_t vec_size) {
 
 /* ------------------------ Config. ------------------------ */
 
-/* ------------------------ Result ------------------------ */
+/* ------------------------ Sweep ------------------------ */
+
+// What a point of the sweep may change, everything else is shared by the points
+static const std::vector<std::string> SWEEP_KEYS = {"T1", "T2", "ZZ", "over_rotation"};
+
+// The config with the values of point k (and "point": k)
+static json sweep_point_config(const json& config, const json& point, std::size_t k) {
+    json ret = config;
+    ret.erase("sweep");
+    for (auto it = point.begin(); it != point.end(); ++it) ret[it.key()] = it.value();
+    ret["point"] = k;
+    return ret;
+}
+
+// Claim of a sweep point: <point_output>.claim with "<host> <pid>" of its process, then "done" once the point finished
+// Claims are never released, the point of a killed process stays claimed (a warning tells it, see --point)
+class SweepClaim {
+public:
+    // No Copy
+    SweepClaim() = default;
+    SweepClaim(const SweepClaim&) = delete;
+    SweepClaim& operator=(const SweepClaim&) = delete;
+
+    ~SweepClaim() {
+        if (!file.empty()) std::ofstream(file, std::ios::app) << "done\n";
+    }
+
+    // Takes the point (of output <point_output>) for this process, false if another process has
+    bool take(const std::string& point_output) {
+        auto claim = point_output + ".claim";
+        int fd = ::open(claim.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+        if (fd < 0) {
+            Assert_msg(errno == EEXIST, "Cannot create " << claim << ": " << std::strerror(errno));
+            warn_if_stale(claim);
+            return false;
+        }
+        auto owner = host_name() + " " + std::to_string(::getpid()) + "\n";
+        Assert_msg(::write(fd, owner.data(), owner.size()) == (ssize_t)owner.size(), "Cannot write " << claim);
+        ::close(fd);
+        file = claim;
+        return true;
+    }
+
+private:
+    std::string file;
+
+    static std::string host_name() {
+        char buf[256] = {};
+        ::gethostname(buf, sizeof(buf) - 1);
+        return buf;
+    }
 
-static void output_jumps(std::ostream& out, Sys* sys) {
-    for (auto& jump : sys->unr.jumps()) {
-        out << (((jump.idx & 1) == 0) ? "Amp(" : "Ph(") << jump.idx / 2 << ") ";
+    // Not done, and its process (of this host) is gone
+    static void warn_if_stale(const std::string& claim) {
+        std::ifstream fin(claim);
+        std::string host, word;
+        long pid = 0;
+        if (!(fin >> host >> pid)) return; // Being written
+        if (fin >> word && word == "done") return;
+        if (host != host_name() || ::kill(pid, 0) == 0 || errno != ESRCH) return;
+        Warn("Stale claim " << claim << ": process " << pid << " is gone, remove the claim or run the point with --point");
     }
-    sys->unr.clear_jumps();
 };
 
-static void dump_result(const std::string& result_file, json& results) {
-    ofstream fout{result_file};
-    fout << results;
+/* ------------------------ Sweep. ------------------------ */
+
+/* ------------------------ Checkpoint ------------------------ */
+
+// What follows the common part of a checkpoint
+enum : std::uint32_t { CHECKPOINT_SAMPLING = 0, CHECKPOINT_ANALYTIC = 1, CHECKPOINT_SPLITTING = 2 };
+
+/* ------------------------ Checkpoint. ------------------------ */
+
+/* ------------------------ Result ------------------------ */
+
+// Self-normalized estimates at every reweighted point
+// log_w[point][trajectory], cycles[trajectory]: #cycles until the logical error
+static json reweight_estimates(json& grid, const std::vector<std::vector<double>>& log_w, const std::vector<double>& cycles) {
+    json ret = json::array();
+    for (std::size_t g = 0; g < log_w.size(); ++g) {
+        double max_log_w = *std::max_element(log_w[g].begin(), log_w[g].end());
+
+        double sum_w = 0, sum_w2 = 0, sum_wc = 0;
+        for (std::size_t i = 0; i < cycles.size(); ++i) {
+            double w = std::exp(log_w[g][i] - max_log_w);
+            sum_w += w;
+            sum_w2 += w * w;
+            sum_wc += w * cycles[i];
+        }
+
+        ret.push_back({
+            {"point", grid[g]},
+            {"mean_cycles", sum_wc / sum_w},
+            {"p_cycle", sum_w / sum_wc},
+            {"ess", sum_w * sum_w / sum_w2}
+        });
+    }
+    return ret;
 }
 
 /* ------------------------ Result. ------------------------ */
@@ -145,94 +250,46 @@ static State init_logical_minus(Sys* sys) {
 }
 
 static void check_logical(const State& s, char type) {
-    State tmp{s};
-    
-    auto check_z = [&s, &tmp](const std::initializer_list<sz_t>& index, bool plus = false) {
-        tmp = s;
-        apply_prim_op_on<SigmaZ>(tmp, index);
-        if (!plus) tmp -= s; else tmp += s;
-        cout << blaze::max(blaze::abs(tmp.vector())) << " ";
-    };
-
-    check_z({0, 3});
-    check_z({1, 2, 4, 5});
-    check_z({3, 4, 6, 7});
-    check_z({5, 8});
-
-    auto check_x = [&s, &tmp](const std::initializer_list<sz_t>& index, bool plus = false) {
-        tmp = s;
-        apply_prim_op_on<SigmaX>(tmp, index);
-        if (!plus) tmp -= s; else tmp += s;
-        cout << blaze::max(blaze::abs(tmp.vector())) << " ";
+    // 1 - <P> (1 + <P> for plus), 0 for a +1 (-1) eigenstate
+    std::vector<std::string> paulis;
+    std::vector<bool> pluses;
+    auto add = [&s, &paulis, &pluses](char p, const std::initializer_list<sz_t>& index, bool plus = false) {
+        std::string str(s.n_freedoms(), 'I');
+        for (auto q : index) str[q] = p;
+        paulis.push_back(str);
+        pluses.push_back(plus);
     };
 
-    check_x({0, 1, 3, 4});
-    check_x({1, 2});
-    check_x({4, 5, 7, 8});
-    check_x({6, 7});
+    add('Z', {0, 3});
+    add('Z', {1, 2, 4, 5});
+    add('Z', {3, 4, 6, 7});
+    add('Z', {5, 8});
 
-    cout << "| ";
+    add('X', {0, 1, 3, 4});
+    add('X', {1, 2});
+    add('X', {4, 5, 7, 8});
+    add('X', {6, 7});
 
-    if (type == '0') check_z({0, 4, 8});
-    else if (type == '1') check_z({0, 4, 8}, true);
-    else if (type == '+') check_x({2, 4, 6});
-    else if (type == '-') check_x({2, 4, 6}, true);
+    if (type == '0') add('Z', {0, 4, 8});
+    else if (type == '1') add('Z', {0, 4, 8}, true);
+    else if (type == '+') add('X', {2, 4, 6});
+    else if (type == '-') add('X', {2, 4, 6}, true);
     else Error("Unknown type: " << type);
 
-    cout << endl;
-}
-
-/* ------------------------ Init. ------------------------ */
-
-/* ------------------------ Extraction ------------------------ */
-
-static void measurement_result_flip(sz_t& res, sz_t n_qubits, sz_t meas, double p_meas_flip, std::mt19937& eng) {
-    std::uniform_real_distribution<double> rand;
-    
-    for (sz_t q = 0; q < n_qubits; ++q) {
-        sz_t idx = (1 << (n_qubits - 1 - q));
-        if ((meas & idx) && rand(eng) < p_meas_flip) {
-            cout << q << " ";
-            res ^= idx;
-        }
-    }
-}
-
-static void reset(State& s, sz_t n_qubits, sz_t meas) {
-    SigmaX x{0};
-    for (sz_t q = 0; q < n_qubits; ++q) {
-        if (meas & (1 << (n_qubits - 1 - q))) {
-            x.on(q).inplace_apply(s, 0);
-        }
+    auto e = pauli_expectations(s, paulis);
+    for (std::size_t i = 0; i < e.size(); ++i) {
+        if (i + 1 == e.size()) cout << "| ";
+        cout << (pluses[i] ? 1 + e[i] : 1 - e[i]) << " ";
     }
-}
-
-/* ------------------------ Extraction. ------------------------ */
-
-/* ------------------------ Correct ------------------------ */
-
-static void correct(std::unordered_map<Syndrome, CorrectionLayer*>& decode, Syndrome& syndrome, State& s, ODESolver* solver, const string& indent) {
-    bool noise_free = (solver == nullptr);
 
-    cout << indent << "Syndrome: " << syndrome << endl;
-    CorrectionLayer* cly = decode.at(syndrome);
-    if (cly) {
-        cout << indent << "Correction: " << endl;
-        cly->diagnose(cout, indent + "  ");
-
-        cly->apply_layer(s, solver, noise_free);
-
-        cout << indent << "  Jumps: "; output_jumps(cout, cly->sys); cout << endl;
-    } else {
-        cout << indent << "Correction: None" << endl;
-    }
+    cout << endl;
 }
 
-/* ------------------------ Correct. ------------------------ */
+/* ------------------------ Init. ------------------------ */
 
 /* ------------------------ Pauli ------------------------ */
 
-static void apply_2q_pauli_error(State& s, const std::vector<Coupling>& cps, double p, std::mt19937& eng) {
+static void apply_2q_pauli_error(State& s, const std::vector<Coupling>& cps, double p, RandomEngine& eng) {
     std::uniform_real_distribution<double> rand;
     std::uniform_int_distribution<int> rand_idx{0, 15};
 
@@ -266,12 +323,20 @@ int main(int argc, char** argv) {
 
     std::string config_file_name;
     std::string result_file;
+    bool compile_decoders = false;
+    bool compile_artifacts = false;
+    bool resume = false;
+    int only_point = -1;
     {
         cxxopts::Options options(argv[0], "Surface Code Simulation");
 
         options.add_options()
             ("c,config", "Config file", cxxopts::value<std::string>()->default_value("config.json"), "filename")
-            ("o,output", "Result output file", cxxopts::value<std::string>()->default_value("surface.json"))
+            ("o,output", "Result output, appended to <output>.<k>.jsonl", cxxopts::value<std::string>()->default_value("surface"))
+            ("resume", "Continue the run of the checkpoint <output>.ckpt (<output>.p<k>.ckpt of --point k in a sweep)")
+            ("point", "Run only this point of the sweep (no claim, e.g. a point left claimed by a killed process)", cxxopts::value<int>()->default_value("-1"))
+            ("compile_decoders", "Write the decoder tables of the config as binary files (<file>.bin) and exit")
+            ("compile_artifacts", "Write the shared operators of the config (and of every sweep point) to its artifact file and exit")
             ("h,help", "Print usage");
 
         auto result = options.parse(argc, argv);
@@ -283,6 +348,10 @@ int main(int argc, char** argv) {
 
         config_file_name = result["config"].as<std::string>();
         result_file = result["output"].as<std::string>();
+        compile_decoders = result.count("compile_decoders");
+        compile_artifacts = result.count("compile_artifacts");
+        resume = result.count("resume");
+        only_point = result["point"].as<int>();
     }
 
     // Load config
@@ -300,17 +369,69 @@ int main(int argc, char** argv) {
         cout << "  MKL: " << mkl_get_max_threads() << endl;
     }
 
-    // Random
-    std::mt19937 eng;
-    {
-        auto seed = config["seed"].get<std::mt19937::result_type>();
-        if (seed == 0) {
-            seed = std::random_device()();
-            std::cout << "Using seed = " << seed << std::endl;
+    // Sweep (config "sweep": [{"T1": ..., "ZZ": ...}, ...], optional): points with their own T1, T2, ZZ, over_rotation
+    // Layers, pulses, decoders and circuits are built once, only the system parameters are reset for every point
+    // Point k writes <output>.p<k>.*.jsonl, the processes of one output share the points, each takes the next one unclaimed
+    bool use_sweep = config.count("sweep");
+    std::vector<json> sweep_points{json::object()};
+    if (use_sweep) {
+        sweep_points.clear();
+        for (auto& point : config["sweep"]) {
+            for (auto it = point.begin(); it != point.end(); ++it) {
+                Assert_msg(std::find(SWEEP_KEYS.begin(), SWEEP_KEYS.end(), it.key()) != SWEEP_KEYS.end(),
+                           "A sweep point can not change " << it.key() << " (only T1, T2, ZZ, over_rotation)");
+            }
+            sweep_points.push_back(point);
         }
-        eng.seed(seed);
+        Assert(!sweep_points.empty());
+        // A point has to end for the next one to start
+        Assert_msg(sweep_points.size() == 1 || config.count("splitting") ||
+                   (config.count("stop") && (config["stop"].count("max_trajectories") || config["stop"].count("time_budget"))),
+                   "A sweep of many points needs \"splitting\" or a \"stop\" with \"max_trajectories\" or \"time_budget\"");
+        cout << "Sweep " << sweep_points.size() << " points" << endl;
+    }
+    Assert_msg(only_point < (int)sweep_points.size(), "No point " << only_point);
+    auto point_config = [&](std::size_t k) { return use_sweep ? sweep_point_config(config, sweep_points[k], k) : config; };
+    auto point_output = [&](std::size_t k) { return use_sweep ? result_file + ".p" + std::to_string(k) : result_file; };
+
+    // Checkpoint (config "checkpoint": {"interval": seconds}, optional) to <output>.ckpt, taken between cycles
+    // Common part: mode, config (of the point), seed, run id, #records, see CHECKPOINT_*
+    double checkpoint_interval = 0.;
+    if (config.count("checkpoint")) {
+        auto& def = config["checkpoint"];
+        checkpoint_interval = def.count("interval") ? def["interval"].get<double>() : 600.;
+        Assert(checkpoint_interval > 0);
+    }
+    std::unique_ptr<CheckpointReader> resume_from;
+    std::uint32_t resume_mode = 0;
+    std::uint64_t resume_seed = 0, resume_run_id = 0, resume_records = 0;
+    if (resume) {
+        Assert_msg(!use_sweep || only_point >= 0, "--resume of a sweep needs --point");
+        std::size_t k = use_sweep ? only_point : 0;
+        auto checkpoint_file = point_output(k) + ".ckpt";
+        Assert_msg(CheckpointReader::exists(checkpoint_file), "No checkpoint " << checkpoint_file << " to resume");
+        resume_from.reset(new CheckpointReader(checkpoint_file));
+        resume_from->get(resume_mode);
+        Assert_msg(resume_from->get<std::string>() == point_config(k).dump(), "Config differs from the one of " << checkpoint_file);
+        resume_from->get(resume_seed);
+        resume_from->get(resume_run_id);
+        resume_from->get(resume_records);
+        cout << "Resume run " << resume_run_id << " from " << checkpoint_file << " (" << resume_records << " records)" << endl;
     }
 
+    // Random
+    // Every trajectory has its own streams: one for the dynamics (jumps, over rotation), one for the measurements
+    std::uint64_t seed = config["seed"].get<std::uint64_t>();
+    if (resume_from) {
+        seed = resume_seed;
+    } else if (seed == 0) {
+        std::random_device rd;
+        seed = (static_cast<std::uint64_t>(rd()) << 32) | rd();
+        std::cout << "Using seed = " << seed << std::endl;
+    }
+    RandomEngine eng{seed, 0, SurfaceRun::STREAM_DYNAMICS};
+    RandomEngine meas_eng{seed, 0, SurfaceRun::STREAM_MEASURE};
+
     // Sys
     StatePool pool;
     Sys* sys;
@@ -334,35 +455,36 @@ int main(int argc, char** argv) {
         sys->topo.push_back({e_j[0].get<sz_t>(), e_j[1].get<sz_t>()});
     }
 
-    // ZZ
-    sys->reset_zz_strength(load_d_vec(config["ZZ"], sys->topo.size()));
-
-    // Relaxation
-    sys->reset_relaxation(load_d_vec(config["T1"], sys->n_qubits), load_d_vec(config["T2"], sys->n_qubits));
-
-    // Over rotation
-    {
-        double or_mean = config["over_rotation"]["mean"].get<double>();
-        double or_std = config["over_rotation"]["std"].get<double>();
-        if (or_std) {
-            cout << "Use over rotation ~ N(" << or_mean << ", " << or_std << ")" << endl;
-            sys->is_over_rotation_enabled = true;
-            sys->over_rotation_dis.param(
-                std::normal_distribution<double>::param_type{or_mean + 1, or_std}
-            );
+    // Artifacts (config "artifacts": file, optional): zz, sum_LdagL and the rz layers are mapped from the file written
+    // by --compile_artifacts, one copy per node instead of one per process. Ops not in the file are built as before
+    std::unique_ptr<ArtifactStore> artifacts;
+    if (config.count("artifacts")) {
+        artifacts.reset(new ArtifactStore(config["artifacts"].get<string>(), compile_artifacts));
+        sys->artifacts = artifacts.get();
+        if (!compile_artifacts) {
+            if (artifacts->is_mapped()) cout << "Map artifacts " << artifacts->file() << endl;
+            else cout << "No artifact file " << artifacts->file() << ", build every operator (see --compile_artifacts)" << endl;
         }
+    } else {
+        Assert_msg(!compile_artifacts, "No \"artifacts\" file in the config");
     }
 
-    // Diagnose system
-    cout << "System:" << endl;
-    sys->diagnose(cout, "    ");
+    // Pulse tables (config "pulse_table", optional): interpolated envelopes, exact pulses without
+    if (config.count("pulse_table")) {
+        auto& pt = config["pulse_table"];
+        sz_t n_pieces = pt.count("pieces") ? pt["pieces"].get<sz_t>() : 16;
+        sz_t degree = pt.count("degree") ? pt["degree"].get<sz_t>() : 12;
+        sys->tabulate_pulses(n_pieces, degree, cout);
+    }
 
     // Load extraction
     std::vector<Layer> extraction;
     {
         json def;
         safe_open_r(config["extraction"].get<string>()) >> def;
-        extraction = Layer::parse_layers(sys, def);
+        // Virtual Z (config "virtual_z", default on): rz layers become frame changes of the later drives
+        bool virtual_z = !config.count("virtual_z") || config["virtual_z"].get<bool>();
+        extraction = Layer::parse_layers(sys, def, virtual_z);
     }
 
     // Diagnose extraction
@@ -372,6 +494,15 @@ int main(int argc, char** argv) {
         ly.diagnose(cout, "    ");
     }
 
+    // Fuse the runs of simulated extraction layers (config "fuse_layers", default on)
+    bool fuse_layers = !config.count("fuse_layers") || config["fuse_layers"].get<bool>();
+    auto schedules = Schedule::compile(extraction, fuse_layers);
+    cout << "Extraction: " << extraction.size() << " layers in " << schedules.size() << " schedules" << endl;
+    for (size_t i = 0; i < schedules.size(); ++i) {
+        cout << "Schedule " << i << ":" << endl;
+        schedules[i].diagnose(cout, "    ");
+    }
+
     // Load extraction perfect
     Circuit extraction_perfect;
     {
@@ -396,29 +527,77 @@ int main(int argc, char** argv) {
 
     // Syndrome
     sz_t n_rounds = config["n_rounds"].get<sz_t>();
-    Assert(n_rounds * sys->n_qubits <= Syndrome::MAX_LEN);
-    Syndrome::set_syndrome_len(sys->n_qubits);
+    Assert(n_rounds * sys->ancilla_qubits.size() <= Syndrome::MAX_LEN);
+    Syndrome::set_ancillas(sys->n_qubits, sys->ancilla_qubits);
+
+    // Decoder tables in JSON, or precompiled by --compile_decoders (mapped, not parsed)
+    auto load_decoder = [sys](const std::string& file_name, sz_t n_rounds) {
+        if (Decoder::is_binary(file_name)) return Decoder::load_binary(sys, file_name, n_rounds);
+
+        json def;
+        safe_open_r(file_name) >> def;
+        return Decoder::parse_decoder(sys, def, n_rounds);
+    };
 
     // Load decoder
     Decoder decoder;
     {
-        json def;
-        safe_open_r(config["decoder"].get<string>()) >> def;
-        decoder = Decoder::parse_decoder(sys, def, n_rounds);
+        Timer t{"Load decoder"};
+        decoder = load_decoder(config["decoder"].get<string>(), n_rounds);
     }
     cout << "Decoder:" << endl;
     decoder.diagnose(cout, "    ");
 
     // Load decoder perfect
-    Decoder decoder_perfect;
-    {
-        json def;
-        safe_open_r(config["decoder_perfect"].get<string>()) >> def;
-        decoder_perfect = Decoder::parse_decoder(sys, def, 1);
-    }
+    Decoder decoder_perfect = load_decoder(config["decoder_perfect"].get<string>(), 1);
     cout << "Decoder(Perfect):" << endl;
     decoder_perfect.diagnose(cout, "    ");
 
+    if (compile_decoders) {
+        for (auto key : {"decoder", "decoder_perfect"}) {
+            auto file_name = config[key].get<string>();
+            auto& d = (string(key) == "decoder") ? decoder : decoder_perfect;
+            if (Decoder::is_binary(file_name) || !d.is_table()) continue;
+
+            d.write_binary(file_name + ".bin");
+            cout << "Compiled " << file_name << " to " << file_name + ".bin" << endl;
+        }
+        return 0;
+    }
+
+    if (compile_artifacts) {
+        // The rz layers are built above, zz and sum_LdagL of every point here
+        for (std::size_t k = 0; k < sweep_points.size(); ++k) {
+            json pconfig = point_config(k);
+            sys->reset_zz_strength(load_d_vec(pconfig["ZZ"], sys->topo.size()));
+            sys->reset_relaxation(load_d_vec(pconfig["T1"], sys->n_qubits), load_d_vec(pconfig["T2"], sys->n_qubits));
+        }
+        artifacts->write();
+        cout << "Compiled " << artifacts->n_private() << " operators to " << artifacts->file() << endl;
+
+        delete sys;
+        return 0;
+    }
+
+    // Event log (config "event_log", optional): binary file written in the background (render with eventlog), text to cout otherwise
+    // level: 0 cycles and logical errors, 1 + rounds, measurements and corrections, 2 + layers and jumps
+    std::unique_ptr<EventLog> event_log;
+    {
+        int level = 2;
+        if (config.count("event_log")) {
+            auto& def = config["event_log"];
+            if (def.count("level")) level = def["level"].get<int>();
+            if (def.count("file")) {
+                std::size_t capacity = def.count("capacity") ? def["capacity"].get<std::size_t>() : (1 << 16);
+                auto file_name = def["file"].get<string>();
+                // A resumed run continues the log (the events after the checkpoint are in it twice)
+                event_log.reset(new EventLog(file_name, sys->n_qubits, Syndrome::SYNDROME_LEN, level, capacity, resume));
+                cout << "Log events (level " << level << ") to " << file_name << endl;
+            }
+        }
+        if (!event_log) event_log.reset(new EventLog(cout, sys->n_qubits, Syndrome::SYNDROME_LEN, level));
+    }
+
     // Init state
     std::string _init_type = config["init_state"].get<std::string>();
     Assert(_init_type.size() == 1);
@@ -444,6 +623,13 @@ int main(int argc, char** argv) {
         default: break;
     }
 
+    // Skip empty blocks of amplitudes (e.g. after measurements), carried over to every trajectory by s = init_state
+    if (config.count("block_size") && config["block_size"].get<sz_t>()) {
+        sz_t block_size = config["block_size"].get<sz_t>();
+        init_state.track_blocks(block_size);
+        cout << "Track empty blocks of " << block_size << " amplitudes, initially occupied: " << init_state.occupied_fraction() << endl;
+    }
+
     // Pauli 2q error
     // double p_2q = config["p_2q"].get<double>();
     // cout << "Use 2Q Pauli error with p = " << p_2q << endl;
@@ -453,137 +639,454 @@ int main(int argc, char** argv) {
     solver.set_atol(config["atol"].get<double>());
     solver.set_rtol(config["rtol"].get<double>());
 
-    // Result output
-    cout << "Output results to " << result_file << endl;
-    json results;
-    results["config"] = config;
-    results["cycles"] = json::array();
-    /* ------------------------ Configuration finished. ------------------------ */
-
-    cout << "================================" << endl;
-    
-    while (true) {
-        solver.set_suggested_first_step_size(0.0);
-        
-        // 1. Init
-        auto s_g = pool.allocate_similar(init_state);
-        auto& s = s_g.state;
-        s = init_state;
-
-        // 2. Repeat extraction x n_rounds + correct + detect logical error
-        //    Until one logical error is detected
-        for (sz_t cycle = 0; true; ++cycle) {
-            cout << "Cycle " << cycle << ":" << endl;
-
-            Syndrome syndromeX;
-            Syndrome syndromeZ;
-
-            // 2.1. Extraction x n_rounds
-            for (sz_t i = 1; i <= n_rounds; ++i) {
-                Timer t{"  Syndrome Extraction " + std::to_string(i)};
-
-                cout << t.msg << ":" << endl;
-                
-                // 2.1.1 Extraction
-                sys->unr.new_trajectory();
-                cout << "    Layer(" << extraction.size() << "): "; cout.flush();
-                for (sz_t layer_i = 0; layer_i < extraction.size(); ++layer_i) {
-                    auto& layer = extraction[layer_i];
-                    layer.apply_layer(s, &solver);
-                    
-                    cout << layer_i << ' ';
-
-                    output_jumps(cout, sys);
-                    // if (layer.is_2q() && p_2q) apply_2q_pauli_error(s, layer.rzx, p_2q, eng);
-
-                    cout.flush();
-                }
-                cout << endl;
-
-                // 2.1.2 Measure
-                cout << "    Measure(T = " << meas_layer.duration << "): ";
-                // 2.1.2.1 Idle + ID
-                if (meas_layer.duration) {
-                    meas_layer.apply_layer(s, &solver);
-                    
-                    output_jumps(cout, sys);
-                }
-                cout << std::endl;
-
-                // 2.1.2.2 Perfect measure
-                sz_t resX = s.measure2(decoder.measX, eng); syndromeX.shift_in(resX);
-                sz_t resZ = s.measure2(decoder.measZ, eng); syndromeZ.shift_in(resZ);
+    /* ------------------------ Points ------------------------ */
+
+    for (std::size_t k = 0; k < sweep_points.size(); ++k) {
+        if (only_point >= 0 && k != (std::size_t)only_point) continue;
+
+        json pconfig = point_config(k);
+        std::string output = point_output(k);
+        SweepClaim claim;
+        if (use_sweep && only_point < 0 && !claim.take(output)) continue;
+        if (use_sweep) cout << "================ Point " << k << ": " << sweep_points[k] << endl;
+
+        // ZZ
+        sys->reset_zz_strength(load_d_vec(pconfig["ZZ"], sys->topo.size()));
+
+        // Relaxation (also clears the prefix cache)
+        sys->reset_relaxation(load_d_vec(pconfig["T1"], sys->n_qubits), load_d_vec(pconfig["T2"], sys->n_qubits));
+
+        // Over rotation
+        {
+            double or_mean = pconfig["over_rotation"]["mean"].get<double>();
+            double or_std = pconfig["over_rotation"]["std"].get<double>();
+            sys->is_over_rotation_enabled = or_std != 0.;
+            if (or_std) {
+                cout << "Use over rotation ~ N(" << or_mean << ", " << or_std << ")" << endl;
+                sys->over_rotation_dis.param(
+                    std::normal_distribution<double>::param_type{or_mean + 1, or_std}
+                );
+            }
+        }
 
-                cout << "      X: "; output_meas(resX); cout << endl;
-                cout << "      Z: "; output_meas(resZ); cout << endl;
+        // Prefix cache of no-jump evolutions, only when every trajectory sees the same pulses
+        // Opt-in, "prefix_cache": true or {"max_bytes": ..., "max_entries": ...}
+        bool use_prefix_cache = config.count("prefix_cache") &&
+                                (config["prefix_cache"].is_object() || config["prefix_cache"].get<bool>());
+        if (use_prefix_cache && !sys->is_over_rotation_enabled) {
+            auto& pc = config["prefix_cache"];
+            if (pc.is_object() && pc.count("max_bytes")) sys->prefix_cache.set_max_bytes(pc["max_bytes"].get<std::size_t>());
+            if (pc.is_object() && pc.count("max_entries")) sys->prefix_cache.set_max_entries(pc["max_entries"].get<std::size_t>());
+            cout << "Use prefix cache" << endl;
+            sys->unr.set_prefix_cache(&sys->prefix_cache);
+        } else {
+            use_prefix_cache = false;
+            sys->unr.set_prefix_cache(nullptr);
+        }
 
-                // 2.1.2.3 Flip
-                if (p_meas_flip) {
-                    cout << "    Flip:" << endl;
+        // Likelihood-ratio reweighting to other T1 / T2 (config "reweight_grid", optional)
+        // Every trajectory also serves the points of the grid, see Jump::log_likelihood_ratio
+        std::vector<std::vector<double>> reweight_scales;
+        if (config.count("reweight_grid")) {
+            for (auto& point : config["reweight_grid"]) {
+                auto T1 = point.count("T1") ? load_d_vec(point["T1"], sys->n_qubits) : sys->T1;
+                auto T2 = point.count("T2") ? load_d_vec(point["T2"], sys->n_qubits) : sys->T2;
+                reweight_scales.push_back(sys->relaxation_scales(T1, T2));
+            }
+            sys->unr.set_record_statistics(true);
+            cout << "Reweight to " << reweight_scales.size() << " points (prefix cache not used)" << endl;
+        }
+        std::vector<std::vector<double>> reweight_log_w(reweight_scales.size()); // [point][trajectory]
+        std::vector<double> reweight_cycles; // [trajectory]
+
+        // Diagnose system
+        cout << "System:" << endl;
+        sys->diagnose(cout, "    ");
+        if (artifacts) {
+            cout << "Artifacts: " << artifacts->n_shared() << " shared, " << artifacts->n_private() << " private operators" << endl;
+            // Ops missing from a mapped file: a stale file (another config or sweep), every process holds its own copy
+            if (artifacts->is_mapped() && artifacts->n_private() > 0) {
+                Warn(artifacts->n_private() << " operators are not in " << artifacts->file() << ", rerun --compile_artifacts");
+            }
+        }
 
-                    cout << "      X: "; measurement_result_flip(resX, sys->n_qubits, decoder.measX, p_meas_flip, eng); cout << endl;
+        std::string checkpoint_file = output + ".ckpt";
+        std::uint64_t run_id = resume_run_id;
+        if (!resume_from) {
+            std::random_device rd;
+            run_id = (static_cast<std::uint64_t>(rd()) << 32) | rd();
+        }
 
-                    cout << "         "; output_meas(resX); cout << endl;
+        // Result output (config "result_sink", optional): the config once, then a record per event, see ResultSink
+        ResultSink::Options sink_opt;
+        if (config.count("result_sink")) {
+            auto& def = config["result_sink"];
+            if (def.count("sync_records")) sink_opt.sync_records = def["sync_records"].get<std::size_t>();
+            if (def.count("sync_seconds")) sink_opt.sync_seconds = def["sync_seconds"].get<double>();
+            if (def.count("segment_bytes")) sink_opt.segment_bytes = def["segment_bytes"].get<std::size_t>();
+        }
+        cout << "Output results to " << output << ".*.jsonl" << endl;
+        // A resumed run writes again the records after its checkpoint, the merge keeps the first of every (run, seq)
+        ResultSink results{output, json{{"config", pconfig}, {"seed", seed}, {"run", run_id}}, sink_opt};
+        if (resume_from) results.set_n_records(resume_records);
+
+        // Stop rule (config "stop", optional): run until the per-cycle logical error rate is known well enough
+        StopRule stop;
+        if (config.count("stop")) {
+            auto& def = config["stop"];
+            if (def.count("rel_ci")) stop.set_rel_ci(def["rel_ci"].get<double>());
+            if (def.count("time_budget")) stop.set_time_budget(def["time_budget"].get<double>());
+            if (def.count("min_trajectories")) stop.set_min_samples(def["min_trajectories"].get<std::size_t>());
+            if (def.count("max_trajectories")) stop.set_max_samples(def["max_trajectories"].get<std::size_t>());
+            if (def.count("level")) stop.set_level(def["level"].get<double>());
+        }
+        if (stop.is_enabled()) cout << "Use stop rule: " << config["stop"] << endl;
+        else cout << "No stop rule, run until killed" << endl;
+
+        // Logical error per cycle: 0 for every survived cycle, 1 at the failure
+        std::size_t n_failures = 0;
+        std::size_t n_cycles_total = 0;
+        BatchMeans error_series;
+        SurfaceRun run{
+            sys,
+            &schedules, &meas_layer, p_meas_flip, n_rounds, &decoder,
+            &extraction_perfect, &decoder_perfect,
+            &init_state, &init_state_err,
+            &solver, &eng, &meas_eng,
+            event_log.get()
+        };
+
+        // Multilevel splitting (config "splitting", optional)
+        bool use_splitting = config.count("splitting");
+        Splitting splitting{run, seed};
+        if (use_splitting) {
+            splitting.parse(config["splitting"]);
+            cout << "Use multilevel splitting:" << endl;
+            splitting.diagnose(cout, "    ");
+        }
+        // Analytic logical error check (config "analytic_check", optional)
+        // Every cycle gives the probability q of a detected logical error instead of a sample, the trajectory goes on
+        // with survival S = prod (1 - q) until S < min_survival or max_cycles
+        bool use_analytic = config.count("analytic_check");
+        sz_t analytic_max_cycles = 0;
+        double analytic_min_survival = 1e-6;
+        double analytic_min_prob = 0.;
+        if (use_analytic) {
+            auto& def = config["analytic_check"];
+            analytic_max_cycles = def["max_cycles"].get<sz_t>();
+            if (def.count("min_survival")) analytic_min_survival = def["min_survival"].get<double>();
+            if (def.count("min_prob")) analytic_min_prob = def["min_prob"].get<double>();
+            Assert(analytic_max_cycles > 0);
+            cout << "Use analytic logical error check: " << def << endl;
+        }
 
-                    cout << "      Z: "; measurement_result_flip(resZ, sys->n_qubits, decoder.measZ, p_meas_flip, eng); cout << endl;
-                    cout << "         "; output_meas(resZ); cout << endl;
+        // Checkpoints: the common part, then the one of the mode
+        // The trajectory in flight: state, random streams, over rotation and jump statistics
+        auto last_checkpoint = std::chrono::steady_clock::now();
+        auto checkpoint_due = [&]() {
+            return checkpoint_interval > 0 &&
+                std::chrono::duration<double>(std::chrono::steady_clock::now() - last_checkpoint).count() >= checkpoint_interval;
+        };
+        auto begin_checkpoint = [&](CheckpointWriter& w, std::uint32_t mode) {
+            results.sync(); // The records it counts are on disk before it
+            w.put(mode);
+            w.put(pconfig.dump());
+            w.put(seed);
+            w.put(run_id);
+            w.put<std::uint64_t>(results.n_records());
+        };
+        auto commit_checkpoint = [&](const CheckpointWriter& w) {
+            w.commit(checkpoint_file);
+            last_checkpoint = std::chrono::steady_clock::now();
+        };
+        auto put_trajectory = [&](CheckpointWriter& w, const State& s) {
+            w.put(s);
+            w.put_text(eng);
+            w.put_text(meas_eng);
+            w.put_text(sys->over_rotation_dis);
+            w.put(sys->unr.integrated_populations());
+            w.put(sys->unr.jump_counts());
+        };
+        auto get_trajectory = [&](CheckpointReader& r, State& s) {
+            r.get(s);
+            r.get_text(eng);
+            r.get_text(meas_eng);
+            r.get_text(sys->over_rotation_dis);
+            auto pops = r.get<std::vector<double>>();
+            auto n_jumps = r.get<std::vector<std::size_t>>();
+            sys->unr.set_statistics(std::move(pops), std::move(n_jumps));
+        };
+        if (resume_from) {
+            std::uint32_t mode = use_splitting ? CHECKPOINT_SPLITTING : (use_analytic ? CHECKPOINT_ANALYTIC : CHECKPOINT_SAMPLING);
+            Assert_msg(resume_mode == mode, "Checkpoint of another mode: " << resume_mode << " (expected " << mode << ")");
+        }
+        if (checkpoint_interval > 0) {
+            cout << "Checkpoint every " << checkpoint_interval << " s to " << checkpoint_file << endl;
+            // The cache starts empty after a resume, its hits are close to but not bit-exact with fresh evolutions
+            if (use_prefix_cache) cout << "Warning: a resumed run is not bit-exact with the prefix cache (drop \"prefix_cache\")" << endl;
+        }
+        /* ------------------------ Configuration finished. ------------------------ */
+
+        cout << "================================" << endl;
+
+        if (use_splitting) {
+            // Repeats are independent (seeded by r), a checkpoint after each: the next repeat and p_fail
+            Welford p_fail;
+            std::uint64_t r0 = 0;
+            if (resume_from) {
+                resume_from->get(r0);
+                resume_from->get_text(p_fail);
+                resume_from.reset();
+            }
+            for (std::size_t r = r0; r < splitting.n_repeats; ++r) {
+                double p = splitting.estimate(r);
+                p_fail.add(p);
+
+                results.append({
+                    {"type", "splitting"},
+                    {"repeat", r},
+                    {"n_cycles", splitting.n_cycles},
+                    {"p_fail", p},
+                    {"reach", splitting.reach_fractions},
+                    {"fail", splitting.fail_fractions}
+                });
+
+                Interval ci = p_fail.interval(stop.get_level());
+                double p_cycle = 1 - std::pow(1 - p_fail.mean(), 1. / splitting.n_cycles);
+                cout << "P(logical error in " << splitting.n_cycles << " cycles): " << p_fail.mean()
+                     << " [" << ci.lo << ", " << ci.hi << "], per cycle: " << p_cycle << endl;
+                results.append({
+                    {"type", "estimate"},
+                    {"p_fail", p_fail.mean()},
+                    {"ci", {ci.lo, ci.hi}},
+                    {"p_cycle", p_cycle},
+                    {"n_repeats", p_fail.count()}
+                });
+
+                if (stop.should_stop(p_fail.count(), p_fail.mean(), ci)) {
+                    cout << "Stop: " << stop.reason() << endl;
+                    break;
                 }
 
-                // 2.1.2.4 Reset
-                reset(s, sys->n_qubits, resX | resZ);
+                if (checkpoint_due()) {
+                    CheckpointWriter w;
+                    begin_checkpoint(w, CHECKPOINT_SPLITTING);
+                    w.put<std::uint64_t>(r + 1);
+                    w.put_text(p_fail);
+                    commit_checkpoint(w);
+                }
             }
 
-            // 2.2 Correct
-            cout << "  Correct X:" << endl;
-            correct(decoder.decodeX, syndromeX, s, &solver, "    ");
-
-            cout << "  Correct Z:" << endl;
-            correct(decoder.decodeZ, syndromeZ, s, &solver, "    ");
-
-            // 2.3 Detect logical error
-            cout << "  Detect Logical Error:" << endl;
+            continue;
+        }
 
-            // 2.3.1 Clone
-            auto s2_g = pool.allocate_similar(s);
-            auto& s2 = s2_g.state;
-            s2 = s;
+        if (use_analytic) {
+            // Per trajectory: expected failures 1 - S and expected cycles sum_c S_c (truncated)
+            // Checkpoint: traj, cycle, fails, cycles, survival, mean_cycles, dropped, the trajectory
+            std::vector<double> fails, cycles;
+            std::uint64_t traj0 = 0, cycle0 = 0;
+            if (resume_from) {
+                resume_from->get(traj0);
+                resume_from->get(cycle0);
+                resume_from->get(fails);
+                resume_from->get(cycles);
+            }
+            for (std::uint64_t traj = traj0; ; ++traj) {
+                run.begin_trajectory(seed, traj);
+
+                auto s_g = pool.allocate_similar(init_state);
+                auto& s = s_g.state;
+                s = init_state;
+
+                double survival = 1.;
+                double mean_cycles = 0.;
+                double dropped = 0.;
+                sz_t cycle = 0;
+                if (resume_from) {
+                    cycle = cycle0;
+                    resume_from->get(survival);
+                    resume_from->get(mean_cycles);
+                    resume_from->get(dropped);
+                    get_trajectory(*resume_from, s);
+                    resume_from.reset();
+                }
+                for (; cycle < analytic_max_cycles && survival >= analytic_min_survival; ++cycle) {
+                    if (checkpoint_due()) {
+                        CheckpointWriter w;
+                        begin_checkpoint(w, CHECKPOINT_ANALYTIC);
+                        w.put(traj);
+                        w.put<std::uint64_t>(cycle);
+                        w.put(fails);
+                        w.put(cycles);
+                        w.put(survival);
+                        w.put(mean_cycles);
+                        w.put(dropped);
+                        put_trajectory(w, s);
+                        commit_checkpoint(w);
+                    }
+
+                    event_log->emit(Event::Type::Cycle, cycle);
+
+                    Syndrome syndromeX;
+                    Syndrome syndromeZ;
+                    for (sz_t i = 1; i <= n_rounds; ++i) run.extraction_round(s, i, syndromeX, syndromeZ);
+
+                    run.correct_cycle(s, syndromeX, syndromeZ);
+                    double d;
+                    double q = run.failure_probability(s, analytic_min_prob, &d);
+
+                    mean_cycles += survival;
+                    dropped += survival * d;
+                    survival *= 1. - q;
+                }
 
-            // 2.3.2 Apply circuit, measure, reset, correct
-            extraction_perfect.run(s2);
+                fails.push_back(1. - survival);
+                cycles.push_back(mean_cycles);
+                results.append({
+                    {"type", "analytic"},
+                    {"traj", traj},
+                    {"survival", survival},
+                    {"mean_cycles", mean_cycles},
+                    {"n_cycles", cycle},
+                    {"dropped", dropped}
+                });
+
+                double p = std::accumulate(fails.begin(), fails.end(), 0.) / std::accumulate(cycles.begin(), cycles.end(), 0.);
+                Interval ci = ratio_interval(fails, cycles, stop.get_level());
+
+                cout << "  Logical Error Rate: " << p << " [" << ci.lo << ", " << ci.hi << "]"
+                     << " (" << fails.size() << " trajectories)" << endl;
+                json estimate = {
+                    {"type", "estimate"},
+                    {"method", "analytic"},
+                    {"p_cycle", p},
+                    {"ci", {ci.lo, ci.hi}},
+                    {"n_trajectories", fails.size()}
+                };
+
+                bool stop_now = stop.should_stop(fails.size(), p, ci);
+                if (stop_now) {
+                    cout << "Stop: " << stop.reason() << endl;
+                    estimate["stop_reason"] = stop.reason();
+                }
+                results.append(estimate);
+                if (stop_now) break;
+            }
 
-            Syndrome syndromeX_perfect;
-            Syndrome syndromeZ_perfect;
+            continue;
+        }
 
-            sz_t resX = s2.measure2(decoder_perfect.measX, eng); syndromeX_perfect.shift_in(resX);
-            sz_t resZ = s2.measure2(decoder_perfect.measZ, eng); syndromeZ_perfect.shift_in(resZ);
+        // Checkpoint: traj, cycle, the estimates so far, the trajectory
+        std::uint64_t traj0 = 0, cycle0 = 0;
+        if (resume_from) {
+            resume_from->get(traj0);
+            resume_from->get(cycle0);
+            n_failures = resume_from->get<std::uint64_t>();
+            n_cycles_total = resume_from->get<std::uint64_t>();
+            resume_from->get_text(error_series);
+            resume_from->get(reweight_log_w);
+            resume_from->get(reweight_cycles);
+        }
 
-            reset(s2, sys->n_qubits, resX | resZ);
+        bool stopped = false;
+        for (std::uint64_t traj = traj0; !stopped; ++traj) {
+            run.begin_trajectory(seed, traj);
 
-            cout << "    Correct X:" << endl;
-            correct(decoder_perfect.decodeX, syndromeX_perfect, s2, nullptr, "      ");
+            // 1. Init
+            auto s_g = pool.allocate_similar(init_state);
+            auto& s = s_g.state;
+            s = init_state;
 
-            cout << "    Correct Z:" << endl;
-            correct(decoder_perfect.decodeZ, syndromeZ_perfect, s2, nullptr, "      ");
+            sz_t cycle = 0;
+            if (resume_from) {
+                cycle = cycle0;
+                get_trajectory(*resume_from, s);
+                resume_from.reset();
+            }
 
-            // 2.3.3 Check
-            double fidelity_none = state_fidelity(s2, init_state);
-            double fidelity_err = state_fidelity(s2, init_state_err);
+            // 2. Repeat extraction x n_rounds + correct + detect logical error
+            //    Until one logical error is detected
+            for (; true; ++cycle) {
+                if (checkpoint_due()) {
+                    CheckpointWriter w;
+                    begin_checkpoint(w, CHECKPOINT_SAMPLING);
+                    w.put(traj);
+                    w.put<std::uint64_t>(cycle);
+                    w.put<std::uint64_t>(n_failures);
+                    w.put<std::uint64_t>(n_cycles_total);
+                    w.put_text(error_series);
+                    w.put(reweight_log_w);
+                    w.put(reweight_cycles);
+                    put_trajectory(w, s);
+                    commit_checkpoint(w);
+                }
 
-            cout << "    Check:" << endl;
-            cout << "      Fidelity (none vs error): " << fidelity_none << " " << fidelity_err << endl;
+                event_log->emit(Event::Type::Cycle, cycle);
+
+                Syndrome syndromeX;
+                Syndrome syndromeZ;
+
+                // 2.1. Extraction x n_rounds
+                for (sz_t i = 1; i <= n_rounds; ++i) run.extraction_round(s, i, syndromeX, syndromeZ);
+
+                // 2.2 Correct + 2.3 Detect logical error
+                ++n_cycles_total;
+                if (!run.finish_cycle(s, syndromeX, syndromeZ)) {
+                    error_series.add(0.);
+                } else {
+                    error_series.add(1.);
+                    ++n_failures;
+
+                    event_log->emit(Event::Type::LogicalError, cycle);
+
+                    json failure = {{"type", "failure"}, {"traj", traj}, {"cycle", cycle}};
+                    if (!reweight_scales.empty()) {
+                        reweight_cycles.push_back(cycle + 1);
+                        failure["log_w"] = json::array();
+                        for (std::size_t g = 0; g < reweight_scales.size(); ++g) {
+                            reweight_log_w[g].push_back(sys->unr.log_likelihood_ratio(reweight_scales[g]));
+                            failure["log_w"].push_back(reweight_log_w[g].back());
+                        }
+                    }
+                    results.append(failure);
+
+                    // Estimate, the wider of the binomial and the batched means interval
+                    double p = (double)n_failures / n_cycles_total;
+                    Interval ci = wilson_interval(n_failures, n_cycles_total, stop.get_level());
+                    Interval ci_bm = error_series.interval(stop.get_level());
+                    if (std::isfinite(ci_bm.lo) && ci_bm.half_width() > ci.half_width()) ci = ci_bm;
+
+                    cout << "  Logical Error Rate: " << p << " [" << ci.lo << ", " << ci.hi << "]"
+                         << " (" << n_failures << " / " << n_cycles_total << " cycles)" << endl;
+                    json estimate = {
+                        {"type", "estimate"},
+                        {"p_cycle", p},
+                        {"ci", {ci.lo, ci.hi}},
+                        {"n_failures", n_failures},
+                        {"n_cycles", n_cycles_total},
+                        {"batch_size", error_series.batch_size()}
+                    };
+                    if (!reweight_scales.empty()) {
+                        estimate["reweight"] = reweight_estimates(config["reweight_grid"], reweight_log_w, reweight_cycles);
+                    }
+
+                    if (stop.should_stop(n_failures, p, ci)) {
+                        cout << "Stop: " << stop.reason() << endl;
+                        estimate["stop_reason"] = stop.reason();
+                        stopped = true;
+                    }
+
+                    results.append(estimate);
+                    break;
+                }
 
-            if (fidelity_none > fidelity_err) {
-                cout << "      Logical Error: None" << endl;
-            } else {
-                results["cycles"].push_back(cycle);
+            } // for (; true; ++cycle)
+        } // for (std::uint64_t traj = traj0; !stopped; ++traj)
 
-                cout << "      Logical Error Detected at Cycle " << cycle << endl;
-                dump_result(result_file, results);
-                break;
-            }
+        cout << "Prefix cache: " << sys->prefix_cache.n_hits() << " hits, " << sys->prefix_cache.n_misses() << " misses" << endl;
+    } // for (std::size_t k = 0; k < sweep_points.size(); ++k)
 
-        } // for (sz_t cycle = 0; true; ++cycle)
-    } // while (true)
+    /* ------------------------ Points. ------------------------ */
 
     delete sys;
     return 0;
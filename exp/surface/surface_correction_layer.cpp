@@ -39,15 +39,24 @@ void CorrectionLayer::apply(State& out, const State& s, double t) {
     auto tmpg = sys->pool.allocate_similar(s);
     State& tmp = tmpg.state;
 
+    double p_r180, p_id;
+    if (sys->use_pulse_tables) {
+        double p[3];
+        sys->single_pulses.eval(t, p);
+        p_r180 = p[Sys::PULSE_R180];
+        p_id = p[Sys::PULSE_ID];
+    } else {
+        p_r180 = sys->p_r180(t);
+        p_id = sys->p_id(t);
+    }
+
     // X
-    double p_r180 = sys->p_r180(t);
     for (auto q : x) {
         sys->sx.on(q).apply(tmp, s, t);
         out.axpy(p_r180, tmp);
     }
 
     // ID
-    double p_id = sys->p_id(t);
     for (auto q : id) {
         sys->sx.on(q).apply(tmp, s, t);
         out.axpy(p_id, tmp);
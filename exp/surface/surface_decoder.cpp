@@ -1,31 +1,132 @@
 #include "surface_decoder.h"
 
+#include <algorithm>
+#include <cstring>
+
 sz_t Syndrome::SYNDROME_LEN = 0;
-sz_t Syndrome::SYNDROME_MASK = 0;
+sz_t Syndrome::N_QUBITS = 0;
+sz_t Syndrome::ANCILLA_MASK = 0;
+sz_t Syndrome::ROUND_MASK = 0;
 
 std::ostream& operator<<(std::ostream& out, const Syndrome& syn) {
-    auto& s = syn.syndrome;
+    // Packed ancilla bits, a group per round (oldest first)
+    sz_t n_rounds = Syndrome::MAX_LEN / Syndrome::SYNDROME_LEN;
+
+    for (sz_t r = n_rounds; r-- > 0;) {
+        sz_t bits = syn.syndrome >> (r * Syndrome::SYNDROME_LEN);
+        for (sz_t i = Syndrome::SYNDROME_LEN; i-- > 0;) out << ((bits >> i) & 1);
+        if (r) out << ' ';
+    }
+
+    return out;
+}
+
+/* ------------------------ DecodeTable ------------------------ */
 
-    sz_t n = ((Syndrome::MAX_LEN - 1) / Syndrome::SYNDROME_LEN) * Syndrome::SYNDROME_LEN;
+constexpr std::uint32_t DecodeTable::UNKNOWN;
 
-    for (sz_t i = Syndrome::MAX_LEN; i-- > 0;) {
-        out << s[i];
-        if (i == n) {
-            out << ' ';
-            n -= Syndrome::SYNDROME_LEN;
+void DecodeTable::init(sz_t meas, sz_t n_rounds) {
+    this->meas = meas;
+    this->n_rounds = n_rounds;
+
+    type_bits = Syndrome::pack(meas);
+    Assert_msg((meas & Syndrome::ancilla_mask()) == meas, "Measured qubits are not ancillas: " << meas);
+
+    sz_t k = 0;
+    for (sz_t m = type_bits; m; m &= m - 1) ++k;
+    key_bits = k * n_rounds;
+    Assert(key_bits <= Syndrome::MAX_LEN);
+}
+
+std::uint64_t DecodeTable::key(const Syndrome& syndrome) const {
+    std::uint64_t k = 0;
+    sz_t k_round = key_bits / n_rounds;
+    for (sz_t back = n_rounds; back-- > 0;) {
+        sz_t bits = (syndrome.syndrome >> (back * Syndrome::SYNDROME_LEN)) & ((sz_t(1) << Syndrome::SYNDROME_LEN) - 1);
+        k = (k << k_round) | Syndrome::extract(bits, type_bits);
+    }
+    return k;
+}
+
+std::uint32_t DecodeTable::find(const Syndrome& syndrome) const {
+    std::uint64_t k = key(syndrome);
+
+    if (is_direct() && index && index[k] != UNKNOWN) return index[k];
+
+    auto end = entries + n_entries;
+    auto it = std::lower_bound(entries, end, k, [](const Entry& e, std::uint64_t k) { return e.key < k; });
+    if (it != end && it->key == k) return it->record;
+
+    auto c = cached.find(k);
+    return (c == cached.end()) ? UNKNOWN : c->second;
+}
+
+void DecodeTable::insert(const Syndrome& syndrome, std::uint32_t record) {
+    Assert(record != UNKNOWN);
+    std::uint64_t k = key(syndrome);
+
+    if (is_direct() && !sealed) {
+        if (own_index.empty()) {
+            Assert(index == nullptr); // Not into a mapped table
+            own_index.assign(sz_t(1) << key_bits, UNKNOWN);
+            index = own_index.data();
         }
+        Assert_msg(own_index[k] == UNKNOWN, "Duplicated syndrome: " << syndrome);
+        own_index[k] = record;
+
+    } else if (!sealed) {
+        own_entries.push_back(Entry{k, record, 0});
+
+    } else {
+        Assert_msg(cached.insert({k, record}).second, "Duplicated syndrome: " << syndrome);
     }
 
-    return out;
+    ++n_known;
+}
+
+void DecodeTable::seal() {
+    sealed = true;
+    if (is_direct()) return;
+
+    std::sort(own_entries.begin(), own_entries.end(), [](const Entry& a, const Entry& b) { return a.key < b.key; });
+    for (std::size_t i = 1; i < own_entries.size(); ++i) {
+        Assert_msg(own_entries[i - 1].key != own_entries[i].key, "Duplicated syndrome key: " << own_entries[i].key);
+    }
+
+    entries = own_entries.data();
+    n_entries = own_entries.size();
 }
 
+/* ------------------------ DecodeTable. ------------------------ */
+
+/* ------------------------ Decoder ------------------------ */
+
 Decoder::~Decoder() {
-    for (auto item : decodeX) if (item.second) delete item.second;
-    for (auto item : decodeZ) if (item.second) delete item.second;
+    for (auto ly : recordsX) delete ly;
+    for (auto ly : recordsZ) delete ly;
 }
 
-void Decoder::parse(Sys* sys, nlohmann::json& def, sz_t& meas, std::unordered_map<Syndrome, CorrectionLayer*>& decode, bool is_Z_correction, sz_t n_rounds) {
-    meas = def["measure"].get<sz_t>();
+std::uint32_t Decoder::record(std::vector<CorrectionLayer*>& records, CorrectionLayer* ly) {
+    if (!ly) return 0;
+
+    std::vector<sz_t> key{&records == &recordsX, ly->x.size(), ly->id.size()};
+    key.insert(key.end(), ly->x.begin(), ly->x.end());
+    key.insert(key.end(), ly->id.begin(), ly->id.end());
+    key.insert(key.end(), ly->z.begin(), ly->z.end());
+
+    auto it = record_ids.find(key);
+    if (it != record_ids.end()) {
+        delete ly;
+        return it->second;
+    }
+
+    records.push_back(ly);
+    record_ids.insert({std::move(key), records.size()});
+    return records.size();
+}
+
+void Decoder::parse(nlohmann::json& def, DecodeTable& table, std::vector<CorrectionLayer*>& records, bool is_Z_correction, sz_t n_rounds) {
+    table.init(def["measure"].get<sz_t>(), n_rounds);
 
     auto& syndrome = def["syndrome"];
     auto& correction = def["correction"];
@@ -71,28 +172,251 @@ void Decoder::parse(Sys* sys, nlohmann::json& def, sz_t& meas, std::unordered_ma
         }
         if (ly) ly->init(sys);
 
-        Assert_msg(decode.find(syn) == decode.end(), "Duplicated syndrome: " << syn);
-        decode.insert({syn, ly});
-        
+        table.insert(syn, record(records, ly));
+
         ++syn_it; ++corr_it;
     }
+
+    table.seal();
 }
 
 Decoder Decoder::parse_decoder(Sys* sys, nlohmann::json& def, sz_t n_rounds) {
-    // X
     Decoder d;
-    parse(sys, def["X"], d.measX, d.decodeX, true, n_rounds);
+    d.sys = sys;
+
+    // X
+    if (def["X"].count("stabilizers")) {
+        d.measX = def["X"]["measure"].get<sz_t>();
+        d.tableX.init(d.measX, n_rounds);
+        d.tableX.seal();
+        d.graphX.reset(new GraphDecoder(def["X"], sys->n_qubits, n_rounds));
+    } else {
+        d.parse(def["X"], d.tableX, d.recordsX, true, n_rounds);
+        d.measX = d.tableX.meas;
+    }
 
     // Z
-    parse(sys, def["Z"], d.measZ, d.decodeZ, false, n_rounds);
+    if (def["Z"].count("stabilizers")) {
+        d.measZ = def["Z"]["measure"].get<sz_t>();
+        d.tableZ.init(d.measZ, n_rounds);
+        d.tableZ.seal();
+        d.graphZ.reset(new GraphDecoder(def["Z"], sys->n_qubits, n_rounds));
+        d.id_rest = def["Z"].count("id_rest") && def["Z"]["id_rest"].get<bool>();
+    } else {
+        d.parse(def["Z"], d.tableZ, d.recordsZ, false, n_rounds);
+        d.measZ = d.tableZ.meas;
+    }
 
     return d;
 }
 
+CorrectionLayer* Decoder::lookup(DecodeTable& table, std::vector<CorrectionLayer*>& records, GraphDecoder* graph, bool is_Z_correction, const Syndrome& syndrome) {
+    std::uint32_t r = table.find(syndrome);
+    if (r != DecodeTable::UNKNOWN) return r ? records[r - 1] : nullptr;
+
+    Assert_msg(graph, "Syndrome not in the decoder table: " << syndrome);
+
+    // Decode once, repeated syndromes are served from the table
+    auto qubits = graph->decode(syndrome);
+    CorrectionLayer* ly = nullptr;
+    if (!qubits.empty()) {
+        ly = new CorrectionLayer();
+        if (is_Z_correction) {
+            ly->z = qubits;
+        } else {
+            ly->x = qubits;
+            if (id_rest) {
+                for (auto q : graph->data_qubits()) {
+                    if (std::find(qubits.begin(), qubits.end(), q) == qubits.end()) ly->id.push_back(q);
+                }
+            }
+        }
+        ly->init(sys);
+    }
+
+    r = record(records, ly);
+    table.insert(syndrome, r);
+    return r ? records[r - 1] : nullptr;
+}
+
+/* ------------------------ Binary ------------------------ */
+
+// Layout (native endianness, 8-byte aligned sections):
+//  Header, then for X and Z: Section, index (uint32 x 2^key_bits) or entries (Entry x n_entries), records
+//  A record: #x, #id, #z, then the qubits, all uint32
+namespace {
+
+const char DECODER_MAGIC[8] = {'Q', 'E', 'D', 'E', 'C', 'O', 'D', 'E'};
+const std::uint32_t DECODER_VERSION = 1;
+
+class Header {
+public:
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t n_rounds;
+    std::uint64_t n_qubits;
+    std::uint64_t ancillas; // Syndrome::ancilla_mask()
+};
+
+class Section {
+public:
+    std::uint64_t meas;
+    std::uint64_t key_bits;
+    std::uint64_t n_known;
+    std::uint64_t n_entries;
+    std::uint64_t n_records;
+    std::uint64_t n_record_words;
+};
+
+std::size_t aligned(std::size_t n) { return (n + 7) & ~std::size_t(7); }
+
+}
+
+bool Decoder::is_binary(const std::string& file_name) {
+    std::ifstream f{file_name, std::ios::binary};
+    char magic[8] = {};
+    f.read(magic, sizeof(magic));
+    return f && std::memcmp(magic, DECODER_MAGIC, sizeof(magic)) == 0;
+}
+
+void Decoder::write_binary(const std::string& file_name) const {
+    Assert_msg(is_table(), "Only tables can be written");
+
+    auto fout = safe_open_w(file_name, std::ios::binary);
+    auto pad = [&fout](std::size_t n) {
+        static const char zeros[8] = {};
+        fout.write(zeros, aligned(n) - n);
+    };
+
+    Header h;
+    std::memcpy(h.magic, DECODER_MAGIC, sizeof(h.magic));
+    h.version = DECODER_VERSION;
+    h.n_rounds = tableX.n_rounds;
+    h.n_qubits = Syndrome::N_QUBITS;
+    h.ancillas = Syndrome::ancilla_mask();
+    fout.write((const char*)&h, sizeof(h));
+
+    auto write = [&](const DecodeTable& table, const std::vector<CorrectionLayer*>& records) {
+        std::vector<std::uint32_t> words;
+        for (auto ly : records) {
+            words.push_back(ly->x.size());
+            words.push_back(ly->id.size());
+            words.push_back(ly->z.size());
+            for (auto q : ly->x) words.push_back(q);
+            for (auto q : ly->id) words.push_back(q);
+            for (auto q : ly->z) words.push_back(q);
+        }
+
+        Section sec;
+        sec.meas = table.meas;
+        sec.key_bits = table.key_bits;
+        sec.n_known = table.n_known;
+        sec.n_entries = table.is_direct() ? (sz_t(1) << table.key_bits) : table.n_entries;
+        sec.n_records = records.size();
+        sec.n_record_words = words.size();
+        fout.write((const char*)&sec, sizeof(sec));
+
+        if (table.is_direct()) {
+            std::vector<std::uint32_t> unknown;
+            const std::uint32_t* index = table.index;
+            if (!index) {
+                unknown.assign(sec.n_entries, DecodeTable::UNKNOWN);
+                index = unknown.data();
+            }
+            fout.write((const char*)index, sec.n_entries * sizeof(std::uint32_t));
+            pad(sec.n_entries * sizeof(std::uint32_t));
+        } else {
+            fout.write((const char*)table.entries, sec.n_entries * sizeof(DecodeTable::Entry));
+        }
+
+        fout.write((const char*)words.data(), words.size() * sizeof(std::uint32_t));
+        pad(words.size() * sizeof(std::uint32_t));
+    };
+    write(tableX, recordsX);
+    write(tableZ, recordsZ);
+
+    Assert_msg(fout.good(), "Cannot write " << file_name);
+}
+
+Decoder Decoder::load_binary(Sys* sys, const std::string& file_name, sz_t n_rounds) {
+    Decoder d;
+    d.sys = sys;
+    d.file.reset(new MappedFile(file_name));
+
+    const char* p = d.file->data();
+    const char* end = p + d.file->size();
+    auto take = [&p, end, &file_name](std::size_t n) {
+        Assert_msg(p + n <= end, "Truncated decoder file " << file_name);
+        const char* q = p;
+        p += aligned(n);
+        return q;
+    };
+
+    Header h;
+    std::memcpy(&h, take(sizeof(h)), sizeof(h));
+    Assert_msg(std::memcmp(h.magic, DECODER_MAGIC, sizeof(h.magic)) == 0, file_name << " is not a decoder file");
+    Assert_msg(h.version == DECODER_VERSION, "Unsupported decoder file version " << h.version);
+    Assert_msg(h.n_rounds == n_rounds, "Decoder of " << h.n_rounds << " rounds, " << n_rounds << " expected");
+    Assert_msg(h.n_qubits == Syndrome::N_QUBITS && h.ancillas == Syndrome::ancilla_mask(),
+               "Decoder of other qubits / ancillas");
+
+    auto load = [&](DecodeTable& table, std::vector<CorrectionLayer*>& records, bool is_Z_correction) {
+        Section sec;
+        std::memcpy(&sec, take(sizeof(sec)), sizeof(sec));
+
+        table.init(sec.meas, n_rounds);
+        Assert(table.key_bits == sec.key_bits);
+        table.n_known = sec.n_known;
+
+        // Zero-copy: the index / entries stay in the mapping
+        if (table.is_direct()) {
+            Assert(sec.n_entries == (sz_t(1) << table.key_bits));
+            table.index = reinterpret_cast<const std::uint32_t*>(take(sec.n_entries * sizeof(std::uint32_t)));
+        } else {
+            table.entries = reinterpret_cast<const DecodeTable::Entry*>(take(sec.n_entries * sizeof(DecodeTable::Entry)));
+            table.n_entries = sec.n_entries;
+        }
+        table.sealed = true;
+
+        auto words = reinterpret_cast<const std::uint32_t*>(take(sec.n_record_words * sizeof(std::uint32_t)));
+        auto words_end = words + sec.n_record_words;
+        for (std::uint64_t i = 0; i < sec.n_records; ++i) {
+            Assert(words + 3 <= words_end);
+            std::uint32_t nx = words[0], nid = words[1], nz = words[2];
+            words += 3;
+            Assert(words + nx + nid + nz <= words_end);
+            Assert(!is_Z_correction || (nx == 0 && nid == 0));
+
+            auto ly = new CorrectionLayer();
+            ly->x.assign(words, words + nx); words += nx;
+            ly->id.assign(words, words + nid); words += nid;
+            ly->z.assign(words, words + nz); words += nz;
+            ly->init(sys);
+            records.push_back(ly);
+        }
+    };
+    load(d.tableX, d.recordsX, true);
+    load(d.tableZ, d.recordsZ, false);
+    d.measX = d.tableX.meas;
+    d.measZ = d.tableZ.meas;
+
+    return d;
+}
+
+/* ------------------------ Binary. ------------------------ */
+
 void Decoder::diagnose(std::ostream& out, const std::string& indent) {
-    auto out_ = [&out, &indent](sz_t measure, const std::unordered_map<Syndrome, CorrectionLayer*>& decode) {
+    auto out_ = [&out, &indent](sz_t measure, const DecodeTable& table, const std::vector<CorrectionLayer*>& records, GraphDecoder* graph) {
         out << indent << " measure: "; output_meas(measure); std:: cout << std::endl;
-        out << indent << " #snydrome: " << decode.size() << std::endl;
+        if (graph) {
+            graph->diagnose(out, indent);
+            out << indent << " #cached snydrome: " << table.size() << std::endl;
+            out << indent << " #correction: " << records.size() << std::endl;
+            return;
+        }
+        out << indent << " #snydrome: " << table.size() << std::endl;
+        out << indent << " #correction: " << records.size() << std::endl;
+        out << indent << " table: " << (table.is_direct() ? "direct, " : "sorted, ") << table.key_bits << " key bits" << std::endl;
 
         // sz_t correct = 0;
         // for (auto& d : decode) correct += (d.second == nullptr);
@@ -101,7 +425,9 @@ void Decoder::diagnose(std::ostream& out, const std::string& indent) {
     };
 
     out << indent << "X:" << std::endl;
-    out_(measX, decodeX);
+    out_(measX, tableX, recordsX, graphX.get());
     out << indent << "Z:" << std::endl;
-    out_(measZ, decodeZ);
-}
\ No newline at end of file
+    out_(measZ, tableZ, recordsZ, graphZ.get());
+}
+
+/* ------------------------ Decoder. ------------------------ */
@@ -3,66 +3,150 @@
 
 #include <stdint.h>
 #include <unordered_map>
-#include <array>
-#include <bitset>
+#include <map>
+#include <vector>
+#include <string>
+#include <memory>
 
 #include "base/types.h"
 #include "base/assertion.h"
 
 #include "surface_correction_layer.h"
+#include "surface_graph_decoder.h"
 #include "nlohmann/json.hpp"
+#include "exp_io.h"
 
+// History of the ancilla results of the rounds of a cycle, packed to the ancilla bits (SYNDROME_LEN per round)
 class Syndrome {
 public:
-    static constexpr sz_t MAX_LEN = 96;
-    static sz_t SYNDROME_LEN;
+    static constexpr sz_t MAX_LEN = 64;
+    static sz_t SYNDROME_LEN; // #ancillas
+    static sz_t N_QUBITS;
 
-    using SType = std::bitset<MAX_LEN>;
-    SType syndrome;
+    using SType = std::uint64_t;
+    SType syndrome = 0;
 
+    // m: results (qubit q <-> 1 << (N_QUBITS - 1 - q)) of the ancillas
     void shift_in(sz_t m) {
-        Assert((m & SYNDROME_MASK) == m);
-        syndrome <<= SYNDROME_LEN;
-        syndrome |= SType(m);
+        Assert((m & ANCILLA_MASK) == m);
+        syndrome = (syndrome << SYNDROME_LEN) | extract(m, ANCILLA_MASK);
+    }
+
+    // Results of the round shifted in back rounds ago
+    sz_t result(sz_t back) const {
+        return deposit((syndrome >> (back * SYNDROME_LEN)) & ROUND_MASK, ANCILLA_MASK);
     }
 
     bool operator==(const Syndrome& other) const {
         return syndrome == other.syndrome;
     }
 
-    static void set_syndrome_len(sz_t syndrome_len) {
-        SYNDROME_LEN = syndrome_len;
-        
-        SYNDROME_MASK = 0;
-        for (sz_t i = 0; i < syndrome_len; ++i) {
-            SYNDROME_MASK |= (1 << i);
-        }
+    static void set_ancillas(sz_t n_qubits, const std::vector<sz_t>& ancillas) {
+        N_QUBITS = n_qubits;
+        SYNDROME_LEN = ancillas.size();
+        Assert(SYNDROME_LEN > 0 && SYNDROME_LEN < MAX_LEN);
+
+        ANCILLA_MASK = 0;
+        for (auto q : ancillas) ANCILLA_MASK |= (sz_t(1) << (n_qubits - 1 - q));
+        ROUND_MASK = (sz_t(1) << SYNDROME_LEN) - 1;
     }
 
+    static sz_t ancilla_mask() { return ANCILLA_MASK; }
+
+    // Packed ancilla bits of a mask of qubits
+    static sz_t pack(sz_t m) { return extract(m, ANCILLA_MASK); }
+
     static Syndrome from_results(const std::vector<sz_t>& results) {
         Syndrome res;
         for (auto r : results) res.shift_in(r);
         return res;
     }
 
+    // The bits of x at the ones of mask, gathered to the low bits (pext) / scattered back (pdep)
+    static sz_t extract(sz_t x, sz_t mask) {
+        sz_t res = 0;
+        for (sz_t bit = 1; mask; bit <<= 1, mask &= mask - 1) {
+            if (x & mask & (~mask + 1)) res |= bit;
+        }
+        return res;
+    }
+    static sz_t deposit(sz_t x, sz_t mask) {
+        sz_t res = 0;
+        for (sz_t bit = 1; mask; bit <<= 1, mask &= mask - 1) {
+            if (x & bit) res |= mask & (~mask + 1);
+        }
+        return res;
+    }
+
 private:
-    static sz_t SYNDROME_MASK;
+    static sz_t ANCILLA_MASK;
+    static sz_t ROUND_MASK;
 };
 
 std::ostream& operator<<(std::ostream& out, const Syndrome& syn);
 
 inline void output_meas(sz_t meas) {
-    for (sz_t mask = (1 << (Syndrome::SYNDROME_LEN - 1)); mask != 0; mask >>= 1)
+    for (sz_t mask = (sz_t(1) << (Syndrome::N_QUBITS - 1)); mask != 0; mask >>= 1)
         std::cout << ((meas & mask) ? '1' : '0');
 }
 
-namespace std {  
-struct hash<Syndrome> {
+namespace std {
+template<> struct hash<Syndrome> {
     std::hash<typename Syndrome::SType> hash_fn;
     std::size_t operator()(const Syndrome& s) const { return hash_fn(s.syndrome); }
 };
 }
 
+// Syndrome -> correction record of one stabilizer type (0: none, i: records[i - 1])
+// Keyed by the history of the type's own ancilla bits
+// Tables (inserted before seal()): indexed directly up to MAX_DIRECT_BITS bits, sorted (key, record) entries above
+// Graph decoders (inserted after seal()): a hash map of the decodes cached on demand, never a full index
+// The index / entries are owned or point into a mapped binary decoder file
+class DecodeTable {
+public:
+    static constexpr std::uint32_t UNKNOWN = 0xffffffffu;
+    static constexpr sz_t MAX_DIRECT_BITS = 24;
+
+    class Entry {
+    public:
+        std::uint64_t key;
+        std::uint32_t record;
+        std::uint32_t _pad;
+    };
+
+    void init(sz_t meas, sz_t n_rounds);
+
+    std::uint64_t key(const Syndrome& syndrome) const;
+    bool is_direct() const { return key_bits <= MAX_DIRECT_BITS; }
+
+    std::uint32_t find(const Syndrome& syndrome) const;
+    // Tables: all inserted before seal(), graph decoders: any time
+    void insert(const Syndrome& syndrome, std::uint32_t record);
+    void seal();
+
+    sz_t size() const { return n_known; }
+
+    sz_t meas = 0;
+    sz_t n_rounds = 0;
+    sz_t key_bits = 0;
+
+private:
+    friend class Decoder;
+
+    sz_t type_bits = 0; // meas in the packed ancilla bits
+    sz_t n_known = 0;
+    bool sealed = false;
+
+    std::vector<std::uint32_t> own_index;
+    const std::uint32_t* index = nullptr;
+
+    std::vector<Entry> own_entries;
+    const Entry* entries = nullptr;
+    sz_t n_entries = 0;
+
+    std::unordered_map<std::uint64_t, std::uint32_t> cached;
+};
+
 class Decoder {
 public:
     Decoder() = default;
@@ -78,16 +162,39 @@ public:
 
     static Decoder parse_decoder(Sys* sys, nlohmann::json& def, sz_t n_rounds);
 
+    // Precompiled tables (write_binary), mapped read-only and shared by the processes loading the same file
+    static bool is_binary(const std::string& file_name);
+    static Decoder load_binary(Sys* sys, const std::string& file_name, sz_t n_rounds);
+    void write_binary(const std::string& file_name) const;
+    bool is_table() const { return !graphX && !graphZ; }
+
     void diagnose(std::ostream& out, const std::string& indent = "");
 
+    // Correction of a syndrome (nullptr: none)
+    // A table ("syndrome" + "correction") holds every syndrome, a graph decoder ("stabilizers") decodes on demand into it
+    CorrectionLayer* correctionX(const Syndrome& syndrome) { return lookup(tableX, recordsX, graphX.get(), true, syndrome); }
+    CorrectionLayer* correctionZ(const Syndrome& syndrome) { return lookup(tableZ, recordsZ, graphZ.get(), false, syndrome); }
+
     sz_t measX;
-    std::unordered_map<Syndrome, CorrectionLayer*> decodeX;
+    DecodeTable tableX;
+    std::vector<CorrectionLayer*> recordsX; // Distinct corrections
+    std::unique_ptr<GraphDecoder> graphX;
 
     sz_t measZ;
-    std::unordered_map<Syndrome, CorrectionLayer*> decodeZ;
+    DecodeTable tableZ;
+    std::vector<CorrectionLayer*> recordsZ;
+    std::unique_ptr<GraphDecoder> graphZ;
+    bool id_rest = false; // X corrections of the graph decoder: identity pulses on the other data qubits
 
 private:
-    static void parse(Sys* sys, nlohmann::json& def, sz_t& meas, std::unordered_map<Syndrome, CorrectionLayer*>& decode, bool is_Z_correction, sz_t n_rounds);
+    Sys* sys = nullptr;
+    std::unique_ptr<MappedFile> file;
+
+    void parse(nlohmann::json& def, DecodeTable& table, std::vector<CorrectionLayer*>& records, bool is_Z_correction, sz_t n_rounds);
+    // Record of a correction, a new one (owning ly) if no equal record exists
+    std::map<std::vector<sz_t>, std::uint32_t> record_ids;
+    std::uint32_t record(std::vector<CorrectionLayer*>& records, CorrectionLayer* ly);
+    CorrectionLayer* lookup(DecodeTable& table, std::vector<CorrectionLayer*>& records, GraphDecoder* graph, bool is_Z_correction, const Syndrome& syndrome);
 };
 
 
@@ -0,0 +1,312 @@
+#include "surface_graph_decoder.h"
+
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <algorithm>
+
+#include "surface_decoder.h"
+
+static constexpr double INF = std::numeric_limits<double>::infinity();
+
+GraphDecoder::GraphDecoder(nlohmann::json& def, sz_t n_qubits, sz_t n_rounds) : n_qubits(n_qubits), n_rounds(n_rounds) {
+    Assert(n_rounds >= 1);
+
+    // Stabilizers, the ancillas checking every data qubit
+    auto& stabilizers = def["stabilizers"];
+    Assert(stabilizers.is_array() && !stabilizers.empty());
+
+    std::vector<std::vector<sz_t>> checks(n_qubits);
+    for (auto& st : stabilizers) {
+        sz_t a = st["ancilla"].get<sz_t>();
+        Assert(a < n_qubits);
+        for (auto& q_j : st["data"]) {
+            sz_t q = q_j.get<sz_t>();
+            Assert(q < n_qubits);
+            checks[q].push_back(ancillas.size());
+        }
+        ancillas.push_back(a);
+    }
+
+    for (sz_t q = 0; q < n_qubits; ++q) {
+        if (checks[q].empty()) continue;
+        Assert_msg(checks[q].size() <= 2, "Data qubit " << q << " is checked by more than 2 stabilizers");
+        data.push_back(q);
+        space_edges.push_back(SpaceEdge{q, checks[q][0], checks[q].size() == 2 ? checks[q][1] : n_anc()});
+    }
+
+    // Weights
+    double p_data = def.count("p_data") ? def["p_data"].get<double>() : 1e-3;
+    double p_meas = def.count("p_meas") ? def["p_meas"].get<double>() : 0.;
+    Assert(p_data > 0 && p_data < 0.5);
+    Assert(p_meas >= 0 && p_meas < 0.5);
+
+    use_time_edges = (p_meas > 0);
+    w_space = std::log((1 - p_data) / p_data);
+    w_time = use_time_edges ? std::log((1 - p_meas) / p_meas) : INF;
+    if (use_time_edges) {
+        double w_min = std::min(w_space, w_time);
+        len_space = std::max<long long>(1, std::llround(w_space / w_min));
+        len_time = std::max<long long>(1, std::llround(w_time / w_min));
+    }
+
+    if (def.count("method")) {
+        auto m = def["method"].get<std::string>();
+        if (m == "uf") method = Method::UnionFind;
+        else if (m == "mwpm") method = Method::Matching;
+        else Error("Unknown decoding method: " << m);
+    }
+
+    // Space-time graph
+    n_vertices = n_detectors();
+    for (sz_t r = 0; r < n_rounds; ++r) {
+        for (auto& e : space_edges) {
+            sz_t u = r * n_anc() + e.a;
+            sz_t v = (e.b == n_anc()) ? n_vertices++ : r * n_anc() + e.b;
+            add_edge(u, v, len_space, e.q);
+        }
+    }
+    if (use_time_edges) {
+        for (sz_t r = 0; r < n_rounds; ++r) {
+            for (sz_t a = 0; a < n_anc(); ++a) {
+                sz_t u = r * n_anc() + a;
+                sz_t v = (r + 1 < n_rounds) ? u + n_anc() : n_vertices++;
+                add_edge(u, v, len_time, n_qubits);
+            }
+        }
+    }
+    incident.resize(n_vertices);
+
+    shortest_paths();
+}
+
+void GraphDecoder::add_edge(sz_t u, sz_t v, sz_t len, sz_t q) {
+    if (incident.size() <= std::max(u, v)) incident.resize(std::max(u, v) + 1);
+    incident[u].push_back(edges.size());
+    incident[v].push_back(edges.size());
+    edges.push_back(Edge{u, v, len, q});
+}
+
+void GraphDecoder::shortest_paths() {
+    // Floyd-Warshall on the ancillas + boundary, next hop and the data qubit of every direct edge
+    sz_t n = n_anc() + 1;
+    dist.assign(n, std::vector<double>(n, INF));
+    std::vector<std::vector<sz_t>> next(n, std::vector<sz_t>(n, n));
+    std::vector<std::vector<sz_t>> edge_q(n, std::vector<sz_t>(n, n_qubits));
+
+    for (sz_t i = 0; i < n; ++i) { dist[i][i] = 0; next[i][i] = i; }
+    for (auto& e : space_edges) {
+        if (dist[e.a][e.b] <= w_space) continue; // Parallel edges, any one of them
+        dist[e.a][e.b] = dist[e.b][e.a] = w_space;
+        next[e.a][e.b] = e.b; next[e.b][e.a] = e.a;
+        edge_q[e.a][e.b] = edge_q[e.b][e.a] = e.q;
+    }
+
+    for (sz_t k = 0; k < n; ++k) {
+        for (sz_t i = 0; i < n; ++i) {
+            for (sz_t j = 0; j < n; ++j) {
+                if (dist[i][k] + dist[k][j] < dist[i][j]) {
+                    dist[i][j] = dist[i][k] + dist[k][j];
+                    next[i][j] = next[i][k];
+                }
+            }
+        }
+    }
+
+    path.assign(n, std::vector<std::vector<sz_t>>(n));
+    for (sz_t i = 0; i < n; ++i) {
+        for (sz_t j = 0; j < n; ++j) {
+            if (dist[i][j] == INF) continue;
+            for (sz_t u = i; u != j; u = next[u][j]) path[i][j].push_back(edge_q[u][next[u][j]]);
+        }
+    }
+}
+
+std::vector<sz_t> GraphDecoder::defects(const Syndrome& syndrome) const {
+    std::vector<sz_t> events;
+
+    sz_t prev = 0;
+    for (sz_t r = 0; r < n_rounds; ++r) {
+        sz_t m = syndrome.result(n_rounds - 1 - r);
+        sz_t d = m ^ prev;
+        prev = m;
+
+        for (sz_t a = 0; a < n_anc(); ++a) {
+            if (d & (sz_t(1) << (n_qubits - 1 - ancillas[a]))) events.push_back(r * n_anc() + a);
+        }
+    }
+
+    return events;
+}
+
+std::vector<sz_t> GraphDecoder::decode(const Syndrome& syndrome) const {
+    std::vector<bool> flip(n_qubits, false);
+
+    auto events = defects(syndrome);
+    if (!events.empty()) {
+        if (method == Method::Matching && events.size() <= MAX_MATCHING_DEFECTS) decode_matching(events, flip);
+        else decode_uf(events, flip);
+    }
+
+    std::vector<sz_t> qubits;
+    for (sz_t q = 0; q < n_qubits; ++q) if (flip[q]) qubits.push_back(q);
+    return qubits;
+}
+
+// Weighted union-find: clusters of odd parity not touching the boundary grow by half edges, then peeling
+void GraphDecoder::decode_uf(const std::vector<sz_t>& events, std::vector<bool>& flip) const {
+    std::vector<sz_t> parent(n_vertices);
+    std::iota(parent.begin(), parent.end(), 0);
+    std::vector<bool> odd(n_vertices, false);
+    std::vector<bool> boundary(n_vertices, false);
+    std::vector<bool> defect(n_vertices, false);
+
+    for (sz_t v = n_detectors(); v < n_vertices; ++v) boundary[v] = true;
+    for (auto e : events) defect[e] = odd[e] = true;
+
+    auto find = [&parent](sz_t v) {
+        while (parent[v] != v) v = parent[v] = parent[parent[v]];
+        return v;
+    };
+    auto active = [&odd, &boundary](sz_t root) { return odd[root] && !boundary[root]; };
+
+    // Grow + merge
+    std::vector<sz_t> growth(edges.size(), 0);
+    std::vector<sz_t> grown;
+    while (true) {
+        grown.clear();
+        bool any = false;
+
+        for (sz_t k = 0; k < edges.size(); ++k) {
+            auto& e = edges[k];
+            if (growth[k] == 2 * e.len) continue;
+
+            sz_t inc = active(find(e.u)) + active(find(e.v));
+            if (!inc) continue;
+
+            any = true;
+            growth[k] = std::min(2 * e.len, growth[k] + inc);
+            if (growth[k] == 2 * e.len) grown.push_back(k);
+        }
+        if (!any) break;
+
+        for (auto k : grown) {
+            sz_t ru = find(edges[k].u), rv = find(edges[k].v);
+            if (ru == rv) continue;
+            parent[rv] = ru;
+            odd[ru] = (odd[ru] != odd[rv]);
+            boundary[ru] = boundary[ru] || boundary[rv];
+        }
+    }
+    for (auto e : events) Assert_msg(!active(find(e)), "Syndrome cannot be matched");
+
+    // Peel spanning trees of the grown edges, rooted at a boundary vertex when the cluster has one
+    std::vector<bool> visited(n_vertices, false);
+    std::vector<sz_t> order;
+    std::vector<sz_t> parent_edge(n_vertices, edges.size());
+
+    auto bfs = [&](sz_t root) {
+        std::size_t head = order.size();
+        visited[root] = true;
+        order.push_back(root);
+        while (head < order.size()) {
+            sz_t u = order[head++];
+            for (auto k : incident[u]) {
+                auto& e = edges[k];
+                if (growth[k] != 2 * e.len) continue;
+                sz_t v = (e.u == u) ? e.v : e.u;
+                if (visited[v]) continue;
+                visited[v] = true;
+                parent_edge[v] = k;
+                order.push_back(v);
+            }
+        }
+    };
+    for (sz_t v = n_detectors(); v < n_vertices; ++v) if (!visited[v]) bfs(v);
+    for (auto e : events) if (!visited[e]) bfs(e);
+
+    for (std::size_t i = order.size(); i-- > 0;) {
+        sz_t v = order[i];
+        if (!defect[v] || parent_edge[v] == edges.size()) continue;
+
+        auto& e = edges[parent_edge[v]];
+        if (e.q < n_qubits) flip[e.q] = !flip[e.q];
+        defect[v] = false;
+        sz_t u = (e.u == v) ? e.v : e.u;
+        defect[u] = !defect[u];
+    }
+}
+
+// Exact minimum weight matching of the events (and the boundary) by dynamic programming over subsets
+void GraphDecoder::decode_matching(const std::vector<sz_t>& events, std::vector<bool>& flip) const {
+    sz_t k = events.size();
+    sz_t B = n_anc();
+
+    auto round_of = [this](sz_t e) { return e / n_anc(); };
+    auto anc = [this](sz_t e) { return e % n_anc(); };
+
+    auto pair_cost = [&](sz_t i, sz_t j) {
+        sz_t ri = round_of(events[i]), rj = round_of(events[j]);
+        if (ri == rj) return dist[anc(events[i])][anc(events[j])];
+        if (!use_time_edges) return INF;
+        return dist[anc(events[i])][anc(events[j])] + (ri > rj ? ri - rj : rj - ri) * w_time;
+    };
+    // Through the boundary: space (flips) or time (after the last round, no flips)
+    auto time_boundary_cost = [&](sz_t i) {
+        return use_time_edges ? (n_rounds - round_of(events[i])) * w_time : INF;
+    };
+    auto boundary_cost = [&](sz_t i) {
+        return std::min(dist[anc(events[i])][B], time_boundary_cost(i));
+    };
+
+    // dp[mask]: cost of the events in mask, choice[mask]: partner of the lowest event (k: boundary)
+    sz_t n_masks = sz_t(1) << k;
+    std::vector<double> dp(n_masks, INF);
+    std::vector<sz_t> choice(n_masks, k);
+    dp[0] = 0;
+    for (sz_t mask = 1; mask < n_masks; ++mask) {
+        sz_t i = 0;
+        while (!(mask & (sz_t(1) << i))) ++i;
+        sz_t rest = mask ^ (sz_t(1) << i);
+
+        dp[mask] = dp[rest] + boundary_cost(i);
+        choice[mask] = k;
+        for (sz_t j = i + 1; j < k; ++j) {
+            if (!(rest & (sz_t(1) << j))) continue;
+            double c = dp[rest ^ (sz_t(1) << j)] + pair_cost(i, j);
+            if (c < dp[mask]) {
+                dp[mask] = c;
+                choice[mask] = j;
+            }
+        }
+    }
+    Assert_msg(dp[n_masks - 1] < INF, "Syndrome cannot be matched");
+
+    auto apply_path = [&flip](const std::vector<sz_t>& p) {
+        for (auto q : p) flip[q] = !flip[q];
+    };
+
+    for (sz_t mask = n_masks - 1; mask != 0;) {
+        sz_t i = 0;
+        while (!(mask & (sz_t(1) << i))) ++i;
+        sz_t j = choice[mask];
+
+        if (j == k) {
+            if (dist[anc(events[i])][B] <= time_boundary_cost(i)) apply_path(path[anc(events[i])][B]);
+            mask ^= (sz_t(1) << i);
+        } else {
+            apply_path(path[anc(events[i])][anc(events[j])]);
+            mask ^= (sz_t(1) << i) | (sz_t(1) << j);
+        }
+    }
+}
+
+void GraphDecoder::diagnose(std::ostream& out, const std::string& indent) {
+    out << indent << " method: " << (method == Method::UnionFind ? "union-find" : "matching") << std::endl;
+    out << indent << " ancillas: ";
+    for (auto a : ancillas) out << a << ' ';
+    out << std::endl;
+    out << indent << " #data: " << data.size() << std::endl;
+    out << indent << " weights (space, time): " << w_space << " " << w_time << std::endl;
+    out << indent << " graph: " << n_vertices << " vertices, " << edges.size() << " edges" << std::endl;
+}
@@ -0,0 +1,90 @@
+#ifndef _SURFACE_GRAPH_DECODER_H
+#define _SURFACE_GRAPH_DECODER_H
+
+#include <vector>
+#include <string>
+
+#include "base/types.h"
+#include "base/assertion.h"
+
+#include "nlohmann/json.hpp"
+
+class Syndrome;
+
+// Decodes one stabilizer type from its layout, instead of a table of all syndrome histories
+// Space-time detection graph: a vertex per (round, ancilla), detection event = result ^ result of the previous round
+// (the first round is compared with 0, ancillas are reset after every measurement)
+//  - space edges: data qubit q between the two ancillas checking it (or an ancilla and the boundary)
+//  - time edges: measurement flip of an ancilla between consecutive rounds, or after the last round (to the boundary)
+// Time edges only if p_meas > 0, i.e. measurement results are not trusted
+class GraphDecoder {
+public:
+    enum class Method { UnionFind, Matching };
+
+    // def: {"stabilizers": [{"ancilla": a, "data": [q...]}, ...], "p_data": .., "p_meas": .., "method": "uf" | "mwpm"}
+    GraphDecoder(nlohmann::json& def, sz_t n_qubits, sz_t n_rounds);
+
+    // Data qubits to flip
+    std::vector<sz_t> decode(const Syndrome& syndrome) const;
+
+    const std::vector<sz_t>& data_qubits() const { return data; }
+
+    // Above this many detection events Matching falls back to UnionFind
+    static constexpr sz_t MAX_MATCHING_DEFECTS = 16;
+
+    void diagnose(std::ostream& out, const std::string& indent = "");
+
+private:
+    sz_t n_qubits;
+    sz_t n_rounds;
+    Method method = Method::UnionFind;
+
+    std::vector<sz_t> ancillas;
+    std::vector<sz_t> data; // Data qubits in the support of any stabilizer
+
+    // Space edge of a data qubit, b == n_anc: boundary
+    class SpaceEdge {
+    public:
+        sz_t q;
+        sz_t a;
+        sz_t b;
+    };
+    std::vector<SpaceEdge> space_edges;
+    bool use_time_edges;
+
+    // Integer lengths (UnionFind) and weights -log(p / (1 - p)) (Matching)
+    sz_t len_space = 1;
+    sz_t len_time = 1;
+    double w_space;
+    double w_time;
+
+    // Space-time graph for UnionFind, every boundary edge has its own boundary vertex
+    class Edge {
+    public:
+        sz_t u;
+        sz_t v;
+        sz_t len;
+        sz_t q; // Data qubit, n_qubits: time edge
+    };
+    std::vector<Edge> edges;
+    std::vector<std::vector<sz_t>> incident; // Edges at every vertex
+    sz_t n_vertices;
+    sz_t n_detectors() const { return n_rounds * n_anc(); }
+    bool is_boundary(sz_t v) const { return v >= n_detectors(); }
+    void add_edge(sz_t u, sz_t v, sz_t len, sz_t q);
+
+    // Shortest space paths between ancillas (index n_anc: boundary), the data qubits along them
+    std::vector<std::vector<double>> dist;
+    std::vector<std::vector<std::vector<sz_t>>> path;
+    void shortest_paths();
+
+    sz_t n_anc() const { return ancillas.size(); }
+
+    // Detection events, (round - 1) * n_anc + ancilla index
+    std::vector<sz_t> defects(const Syndrome& syndrome) const;
+
+    void decode_uf(const std::vector<sz_t>& events, std::vector<bool>& flip) const;
+    void decode_matching(const std::vector<sz_t>& events, std::vector<bool>& flip) const;
+};
+
+#endif // _SURFACE_GRAPH_DECODER_H
@@ -1,6 +1,7 @@
 #include "surface_layer.h"
 
 #include <string>
+#include <cmath>
 
 #include "exp_util.h"
 #include "exp_sop.h"
@@ -53,11 +54,12 @@ void Layer::setup_over_roration() {
 
 void Layer::diagnose(std::ostream& out, const std::string& indent) {
     out << indent << "Type: " << (is_rz ? "RZ" : "SIM") << std::endl;
-    out << indent << " rz dims: [" << rz.matrix().rows() << ", " << rz.matrix().columns() << "]" << std::endl;
+    out << indent << " rz dims: [" << rz.n_rows() << ", " << rz.n_cols() << "]" << (rz.is_view() ? " (shared)" : "") << std::endl;
     out << indent << " rx: " << rx << std::endl;
     out << indent << " ry: " << ry << std::endl;
     out << indent << " id: " << id << std::endl;
     out << indent << " rzx: " << rzx << std::endl;
+    if (!frame.empty()) out << indent << " frame: " << frame << std::endl;
 }
 
 void Layer::apply_layer(State& s, ODESolver* solver) {
@@ -79,36 +81,47 @@ void Layer::apply(State& out, const State& s, double t) {
     auto tmpg = sys->pool.allocate_similar(s);
     State& tmp = tmpg.state;
 
+    // Envelopes
+    sz_t step = sz_t(t);
+    double p_r90 = 0, p_id;
+    if (sys->use_pulse_tables) {
+        double p[3];
+        sys->single_pulses.eval(t - step, p);
+        p_r90 = p[Sys::PULSE_R90];
+        p_id = p[Sys::PULSE_ID];
+    } else {
+        if (!(rx.empty() & ry.empty())) p_r90 = sys->p_r90(t);
+        p_id = sys->p_id(t - step);
+    }
+
     // 1. Pulse
     if (is_2q()) {
+        double p_zx = sys->use_pulse_tables ? sys->zx_pulses.eval(t) : sys->p_zx(t);
+
         // Rzx(PI/2)
         for (std::size_t i = 0; i < rzx.size(); ++i) {
-            double p_zx = sys->apply_zx(tmp, s, rzx[i].first, rzx[i].second, t);
+            sys->zx_op(rzx[i].first, rzx[i].second, t, phi(rzx[i].second)).apply(tmp, s, t);
             out.axpy(p_zx * or_rzx[i], tmp);
         }
     } else {
-        double p_r90 = (rx.empty() & ry.empty()) ? 0 : sys->p_r90(t);
-
         // Rx(-PI/2)
         for (std::size_t i = 0; i < rx.size(); ++i) {
-            sys->sx.on(rx[i]).apply(tmp, s, t);
+            sys->x_on(rx[i], phi(rx[i])).apply(tmp, s, t);
             out.axpy(-p_r90 * or_rx[i], tmp);
         }
 
         // Ry(PI/2)
         for (std::size_t i = 0; i < ry.size(); ++i) {
-            sys->sy.on(ry[i]).apply(tmp, s, t);
+            if (frame.empty()) sys->sy.on(ry[i]).apply(tmp, s, t);
+            else sys->psx.on(ry[i], M_PI_2 + phi(ry[i])).apply(tmp, s, t);
             out.axpy(p_r90 * or_ry[i], tmp);
         }
     }
 
     // Id
-    sz_t step = sz_t(t);
-    double p_id = sys->p_id(t - step);
-
     if (step >= duration) step = duration - 1;
     for (std::size_t i = 0; i < id.size(); ++i) {
-        sys->sx.on(id[i]).apply(tmp, s, t);
+        sys->x_on(id[i], phi(id[i])).apply(tmp, s, t);
         out.axpy(p_id * or_id[step * id.size() + i], tmp);
     }
 
@@ -122,22 +135,27 @@ void Layer::apply(State& out, const State& s, double t) {
 using nlohmann::json;
 
 Layer Layer::parse_rz(Sys* sys, json& layer) {
-    Layer ly;
-    ly.is_rz = true;
-
-    std::vector<SOp> rzs;
     std::vector<sz_t> targets;
+    std::vector<double> thetas;
 
     for (auto& ins : layer) {
         Assert(ins["name"].get<std::string>() == "rz");
-        sz_t q = ins["qubits"][0].get<sz_t>();
-        double theta = ins["params"][0].get<double>();
-        
-        rzs.push_back(::rz(theta));
-        targets.push_back(q);
+        targets.push_back(ins["qubits"][0].get<sz_t>());
+        thetas.push_back(ins["params"][0].get<double>());
     }
 
-    ly.rz = embed(sys->n_qubits, rzs, targets);
+    return make_rz(sys, targets, thetas);
+}
+
+Layer Layer::make_rz(Sys* sys, const std::vector<sz_t>& targets, const std::vector<double>& thetas) {
+    Layer ly;
+    ly.is_rz = true;
+
+    ly.rz = sys->shared_sop(ArtifactKey{"rz"}.add(sys->n_qubits).add(targets).add(thetas), [&]() {
+        std::vector<SOp> rzs;
+        for (auto theta : thetas) rzs.push_back(::rz(theta));
+        return embed(sys->n_qubits, rzs, targets);
+    });
 
     ly.duration = sys->T_rz;
     ly.init(sys);
@@ -196,11 +214,16 @@ Layer Layer::parse_meas(Sys* sys, nlohmann::json& def) {
     return ly;
 }
 
-std::vector<Layer> Layer::parse_layers(Sys* sys, json& def){
+std::vector<Layer> Layer::parse_layers(Sys* sys, json& def, bool virtual_z) {
     Assert(def.is_array());
 
     std::vector<Layer> layers;
 
+    // U rz(theta) = rz(theta) U' with U' = rz(-theta) U rz(theta): X -> cos(theta) X - sin(theta) Y in U'
+    // rz commutes with ZZ, dephasing and the Z of ZX, and only changes the phase of an amplitude damping jump
+    std::vector<double> frame(sys->n_qubits, 0.);
+    bool has_frame = false;
+
     // std::cout << "#Layers: " << def.size() << std::endl;
     for (auto& layer : def) {
         Assert(layer.is_array());
@@ -211,9 +234,32 @@ std::vector<Layer> Layer::parse_layers(Sys* sys, json& def){
 
         // std::cout << "[Layer " << layers.size() << "] Type: " << (is_rz ? "RZ" : "SIM") << std::endl;
 
-        if (is_rz) layers.push_back(Layer::parse_rz(sys, layer));
-        else layers.push_back(Layer::parse_sim(sys, layer));
+        if (is_rz && virtual_z) {
+            for (auto& ins : layer) {
+                frame[ins["qubits"][0].get<sz_t>()] += ins["params"][0].get<double>();
+                has_frame = true;
+            }
+
+        } else if (is_rz) {
+            layers.push_back(Layer::parse_rz(sys, layer));
+
+        } else {
+            layers.push_back(Layer::parse_sim(sys, layer));
+            if (has_frame) layers.back().frame = frame;
+        }
+    }
+
+    // Residual frame, rz(2k PI) is a global phase
+    std::vector<sz_t> targets;
+    std::vector<double> thetas;
+    for (sz_t q = 0; q < sys->n_qubits; ++q) {
+        double theta = std::remainder(frame[q], 2 * M_PI);
+        if (!almost_equal(theta, 0., 1e-12)) {
+            targets.push_back(q);
+            thetas.push_back(frame[q]);
+        }
     }
+    if (!targets.empty()) layers.push_back(Layer::make_rz(sys, targets, thetas));
 
     return layers;
 }
\ No newline at end of file
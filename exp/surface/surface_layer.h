@@ -18,7 +18,9 @@ public:
 
     void apply(State& out, const State& s, double t) override;
 
-    static std::vector<Layer> parse_layers(Sys* sys, nlohmann::json& def);
+    // virtual_z: rz layers are not simulated, their phases rotate the drive axes of the later layers (frame)
+    // The residual frame is applied by one rz layer at the end (before the measurement), none if it is trivial
+    static std::vector<Layer> parse_layers(Sys* sys, nlohmann::json& def, bool virtual_z = false);
 
     static Layer parse_meas(Sys* sys, nlohmann::json& def);
 
@@ -36,6 +38,9 @@ public:
     std::vector<sz_t> id; // Id
     std::vector<Coupling> rzx; // Rzx(PI/2)
 
+    // Virtual-Z frame of every qubit when the layer starts, empty: none
+    std::vector<double> frame;
+
     // Over rotation, rz is perfect
     std::vector<double> or_rx;
     std::vector<double> or_ry;
@@ -50,12 +55,19 @@ public:
     Sys* sys;
 
 private:
+    friend class Schedule;
+
     void init(Sys* sys);
     
     void setup_over_roration();
 
     static Layer parse_rz(Sys* sys, nlohmann::json& layer);
 
+    static Layer make_rz(Sys* sys, const std::vector<sz_t>& targets, const std::vector<double>& thetas);
+
+    // Drive axis of q in the frame
+    double phi(sz_t q) const { return frame.empty() ? 0. : -frame[q]; }
+
     static Layer parse_sim(Sys* sys, nlohmann::json& layer);
 
     Layer() = default;
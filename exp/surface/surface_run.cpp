@@ -0,0 +1,234 @@
+#include "surface_run.h"
+
+#include <chrono>
+
+#include "exp.h"
+
+using std::string;
+
+static std::uint64_t qubit_mask(const std::vector<sz_t>& qubits, sz_t n_qubits) {
+    std::uint64_t mask = 0;
+    for (auto q : qubits) mask |= std::uint64_t(1) << (n_qubits - 1 - q);
+    return mask;
+}
+
+static void log_jump(EventLog* log, Sys* sys, const JumpInfo& jump) {
+    auto& info = sys->lindblad_info[jump.idx];
+    log->emit(Event::Type::Jump, (info.channel == Sys::Channel::Amp) ? 0 : 1, info.qubit);
+}
+
+// Jumps since the last call
+static void log_jumps(EventLog* log, Sys* sys) {
+    for (auto& jump : sys->unr.jumps()) log_jump(log, sys, jump);
+    sys->unr.clear_jumps();
+}
+
+/* ------------------------ Extraction ------------------------ */
+
+// Returns the flipped results
+static sz_t measurement_result_flip(sz_t& res, sz_t n_qubits, sz_t meas, double p_meas_flip, RandomEngine& eng) {
+    std::uniform_real_distribution<double> rand;
+
+    sz_t flipped = 0;
+    for (sz_t q = 0; q < n_qubits; ++q) {
+        sz_t idx = (1 << (n_qubits - 1 - q));
+        if ((meas & idx) && rand(eng) < p_meas_flip) {
+            flipped |= idx;
+            res ^= idx;
+        }
+    }
+    return flipped;
+}
+
+/* ------------------------ Extraction. ------------------------ */
+
+/* ------------------------ Correct ------------------------ */
+
+static void correct(EventLog* log, CorrectionLayer* cly, Syndrome& syndrome, State& s, ODESolver* solver, std::uint8_t indent) {
+    bool noise_free = (solver == nullptr);
+
+    log->emit(Event::Type::Syndrome, 0, syndrome.syndrome, 0, 0., 0., indent);
+    if (cly) {
+        sz_t n_qubits = cly->sys->n_qubits;
+        if (cly->is_Z_only()) log->emit(Event::Type::Correction, 2, qubit_mask(cly->z, n_qubits), 0, 0., 0., indent);
+        else log->emit(Event::Type::Correction, 1, qubit_mask(cly->x, n_qubits), qubit_mask(cly->id, n_qubits), 0., 0., indent);
+
+        cly->apply_layer(s, solver, noise_free);
+
+        log_jumps(log, cly->sys);
+        log->emit(Event::Type::CorrectionDone);
+    } else {
+        log->emit(Event::Type::Correction, 0, 0, 0, 0., 0., indent);
+    }
+}
+
+/* ------------------------ Correct. ------------------------ */
+
+/* ------------------------ SurfaceRun ------------------------ */
+
+void SurfaceRun::begin_trajectory(std::uint64_t seed, std::uint64_t traj) {
+    solver->set_suggested_first_step_size(0.0);
+    eng->seed(seed, traj, STREAM_DYNAMICS);
+    meas_eng->seed(seed, traj, STREAM_MEASURE);
+    sys->over_rotation_dis.reset();
+    sys->unr.clear_statistics();
+    log->emit(Event::Type::Trajectory, 0, traj);
+}
+
+sz_t SurfaceRun::extraction_round(State& s, sz_t i, Syndrome& syndromeX, Syndrome& syndromeZ) {
+    auto t1 = std::chrono::steady_clock::now();
+
+    // 1 Extraction
+    sys->unr.new_trajectory();
+    sz_t n_layers = 0;
+    for (auto& sch : *extraction) n_layers += sch.size();
+
+    log->emit(Event::Type::Round, i, n_layers);
+    for (auto& sch : *extraction) {
+        sch.apply_schedule(s, solver);
+
+        // Jumps of every layer of the schedule after it
+        auto& jumps = sys->unr.jumps();
+        std::size_t j = 0;
+        for (sz_t k = 0; k < sch.size(); ++k) {
+            log->emit(Event::Type::Layer, sch.index(k));
+            for (; j < jumps.size() && sch.layer_at(jumps[j].time) == k; ++j) log_jump(log, sys, jumps[j]);
+        }
+        sys->unr.clear_jumps();
+    }
+
+    // 2 Measure
+    log->emit(Event::Type::MeasureBegin, 0, 0, 0, meas_layer->duration);
+    // 2.1 Idle + ID
+    if (meas_layer->duration) {
+        meas_layer->apply_layer(s, solver);
+
+        log_jumps(log, sys);
+    }
+
+    // 2.2 Perfect measure, X and Z ancillas jointly, collapsed together with the reset
+    sz_t meas = decoder->measX | decoder->measZ;
+    double weight;
+    sz_t res = s.sample2(meas, *meas_eng, &weight);
+    sz_t resX = res & decoder->measX; syndromeX.shift_in(resX);
+    sz_t resZ = res & decoder->measZ; syndromeZ.shift_in(resZ);
+    sz_t syndrome_bits = resX | resZ;
+
+    log->emit(Event::Type::Measure, 0, resX, resZ);
+
+    // 2.3 Flip
+    if (p_meas_flip) {
+        sz_t flippedX = measurement_result_flip(resX, sys->n_qubits, decoder->measX, p_meas_flip, *meas_eng);
+        log->emit(Event::Type::Flip, 0, flippedX, resX);
+
+        sz_t flippedZ = measurement_result_flip(resZ, sys->n_qubits, decoder->measZ, p_meas_flip, *meas_eng);
+        log->emit(Event::Type::Flip, 1, flippedZ, resZ);
+    }
+
+    // 2.4 Collapse + reset (to the flipped results)
+    s.collapse2(meas, res, resX | resZ, weight);
+
+    auto t2 = std::chrono::steady_clock::now();
+    log->emit(Event::Type::RoundDone, i, 0, 0, std::chrono::duration<double, std::milli>(t2 - t1).count());
+
+    return syndrome_bits;
+}
+
+void SurfaceRun::correct_cycle(State& s, Syndrome& syndromeX, Syndrome& syndromeZ) {
+    log->emit(Event::Type::CorrectBegin, 0, 0, 0, 0., 0., 2);
+    correct(log, decoder->correctionX(syndromeX), syndromeX, s, solver, 4);
+
+    log->emit(Event::Type::CorrectBegin, 1, 0, 0, 0., 0., 2);
+    correct(log, decoder->correctionZ(syndromeZ), syndromeZ, s, solver, 4);
+}
+
+// Perfect syndromes res (after the perfect extraction on s2), reset, correct and compare
+bool SurfaceRun::is_logical_error(State& s2, sz_t res, std::uint8_t indent) {
+    Syndrome syndromeX_perfect;
+    Syndrome syndromeZ_perfect;
+    syndromeX_perfect.shift_in(res & decoder_perfect->measX);
+    syndromeZ_perfect.shift_in(res & decoder_perfect->measZ);
+
+    log->emit(Event::Type::CorrectBegin, 0, 0, 0, 0., 0., indent);
+    correct(log, decoder_perfect->correctionX(syndromeX_perfect), syndromeX_perfect, s2, nullptr, indent + 2);
+
+    log->emit(Event::Type::CorrectBegin, 1, 0, 0, 0., 0., indent);
+    correct(log, decoder_perfect->correctionZ(syndromeZ_perfect), syndromeZ_perfect, s2, nullptr, indent + 2);
+
+    double fidelity_none = state_fidelity(s2, *init_state);
+    double fidelity_err = state_fidelity(s2, *init_state_err);
+
+    log->emit(Event::Type::Check, 0, 0, 0, fidelity_none, fidelity_err, indent);
+
+    return fidelity_none <= fidelity_err;
+}
+
+bool SurfaceRun::finish_cycle(State& s, Syndrome& syndromeX, Syndrome& syndromeZ) {
+    // 1 Correct
+    correct_cycle(s, syndromeX, syndromeZ);
+
+    // 2 Detect logical error
+    log->emit(Event::Type::DetectBegin);
+
+    // 2.1 Clone
+    auto s2_g = sys->pool.allocate_similar(s);
+    auto& s2 = s2_g.state;
+    s2 = s;
+
+    // 2.2 Apply circuit, measure, reset, correct, check
+    extraction_perfect->run(s2);
+    sz_t res = s2.measure_reset2(decoder_perfect->measX | decoder_perfect->measZ, *meas_eng);
+
+    if (!is_logical_error(s2, res, 4)) {
+        log->emit(Event::Type::NoLogicalError);
+        return false;
+    } else {
+        return true;
+    }
+}
+
+double SurfaceRun::failure_probability(const State& s, double min_prob, double* dropped) {
+    log->emit(Event::Type::FailureBegin);
+
+    auto s2_g = sys->pool.allocate_similar(s);
+    auto& s2 = s2_g.state;
+    s2 = s;
+    extraction_perfect->run(s2);
+
+    // Ancilla freedoms, qubit q <-> 1 << (n_qubits - 1 - q)
+    sz_t meas = decoder_perfect->measX | decoder_perfect->measZ;
+    std::vector<sz_t> frees;
+    for (sz_t q = 0; q < sys->n_qubits; ++q) {
+        if (meas & (sz_t(1) << (sys->n_qubits - 1 - q))) frees.push_back(q);
+    }
+    std::vector<double> p = s2.marginal(frees);
+
+    auto s3_g = sys->pool.allocate_similar(s);
+    auto& s3 = s3_g.state;
+
+    double p_fail = 0.;
+    double p_dropped = 0.;
+    for (sz_t k = 0; k < p.size(); ++k) {
+        if (p[k] <= min_prob) {
+            p_dropped += p[k];
+            continue;
+        }
+
+        sz_t res = 0;
+        auto values = s2.outcome_values(frees, k);
+        for (std::size_t j = 0; j < frees.size(); ++j) {
+            if (values[j]) res |= sz_t(1) << (sys->n_qubits - 1 - frees[j]);
+        }
+
+        log->emit(Event::Type::Outcome, 0, res, 0, p[k]);
+        s3 = s2;
+        s3.collapse2(meas, res, res);
+        if (is_logical_error(s3, res, 6)) p_fail += p[k];
+    }
+
+    log->emit(Event::Type::FailureDone, 0, 0, 0, p_fail, p_dropped);
+    if (dropped) *dropped = p_dropped;
+    return p_fail;
+}
+
+/* ------------------------ SurfaceRun. ------------------------ */
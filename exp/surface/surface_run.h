@@ -0,0 +1,66 @@
+#ifndef _SURFACE_RUN_H
+#define _SURFACE_RUN_H
+
+#include <iostream>
+#include <vector>
+#include <string>
+
+#include "ode/zvode.h"
+
+#include "exp_event_log.h"
+
+#include "surface_sys.h"
+#include "surface_layer.h"
+#include "surface_schedule.h"
+#include "surface_decoder.h"
+#include "surface_circuit.h"
+
+// Repeated QEC cycles on one logical qubit
+// A cycle: n_rounds x (extraction + measurement + reset), correction, logical check with a perfect extraction
+class SurfaceRun {
+public:
+    // Random streams of a trajectory
+    enum : std::uint32_t { STREAM_DYNAMICS = 0, STREAM_MEASURE = 1, STREAM_SPLITTING = 2 };
+
+    Sys* sys;
+
+    std::vector<Schedule>* extraction; // Extraction layers, fused into schedules
+    Layer* meas_layer;
+    double p_meas_flip;
+    sz_t n_rounds;
+    Decoder* decoder;
+
+    Circuit* extraction_perfect;
+    Decoder* decoder_perfect;
+
+    const State* init_state;
+    const State* init_state_err;
+
+    ZVODESolver* solver;
+    RandomEngine* eng; // Dynamics, shared with sys
+    RandomEngine* meas_eng;
+
+    EventLog* log = nullptr; // Progress of the trajectories, required
+
+    // Switch to the streams of trajectory traj
+    void begin_trajectory(std::uint64_t seed, std::uint64_t traj);
+
+    // Round i of a cycle (1-based), the results are shifted into the syndromes
+    // Returns the measured results of all ancillas before the flips, the same bits shifted into the syndromes
+    // (the flips only change the results the ancillas are reset to)
+    sz_t extraction_round(State& s, sz_t i, Syndrome& syndromeX, Syndrome& syndromeZ);
+
+    // Correct and check, true if a logical error is detected
+    bool finish_cycle(State& s, Syndrome& syndromeX, Syndrome& syndromeZ);
+
+    // Correct only (the first half of finish_cycle)
+    void correct_cycle(State& s, Syndrome& syndromeX, Syndrome& syndromeZ);
+    // Probability that the check of finish_cycle detects a logical error on the corrected s
+    // Sums over the perfect syndromes instead of sampling one, outcomes with p <= min_prob are dropped (their total in dropped)
+    double failure_probability(const State& s, double min_prob = 0., double* dropped = nullptr);
+
+private:
+    bool is_logical_error(State& s2, sz_t res, std::uint8_t indent);
+};
+
+#endif // _SURFACE_RUN_H
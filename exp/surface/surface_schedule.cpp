@@ -0,0 +1,56 @@
+#include "surface_schedule.h"
+
+#include <algorithm>
+
+#include "exp_print.h"
+
+void Schedule::diagnose(std::ostream& out, const std::string& indent) {
+    out << indent << "Layers: " << indices << std::endl;
+    out << indent << " starts: " << starts << std::endl;
+}
+
+void Schedule::apply_schedule(State& s, ODESolver* solver) {
+    if (is_rz() || size() == 1) {
+        layers[0]->apply_layer(s, solver);
+        return;
+    }
+
+    for (auto layer : layers) layer->setup_over_roration();
+
+    sys->unr.set_H(this);
+    sys->unr.set_breakpoints(std::vector<double>(starts.begin() + 1, starts.end() - 1));
+    sys->unr.solve(solver, s, 0, duration());
+    sys->unr.set_breakpoints({});
+}
+
+void Schedule::apply(State& out, const State& s, double t) {
+    sz_t k = layer_at(t);
+    layers[k]->apply(out, s, t - starts[k]);
+}
+
+sz_t Schedule::layer_at(double t) const {
+    sz_t k = std::upper_bound(starts.begin() + 1, starts.end() - 1, t) - starts.begin() - 1;
+    return k;
+}
+
+std::vector<Schedule> Schedule::compile(std::vector<Layer>& layers, bool fuse) {
+    std::vector<Schedule> schedules;
+
+    for (sz_t i = 0; i < layers.size(); ++i) {
+        auto& layer = layers[i];
+
+        bool append = fuse && !layer.is_rz && !schedules.empty() && !schedules.back().is_rz();
+        if (!append) {
+            schedules.push_back(Schedule{});
+            schedules.back().sys = layer.sys;
+            schedules.back().starts.push_back(0.);
+        }
+
+        auto& sch = schedules.back();
+        sch.layers.push_back(&layer);
+        sch.indices.push_back(i);
+        sch.starts.push_back(sch.starts.back() + layer.duration);
+    }
+
+    return schedules;
+}
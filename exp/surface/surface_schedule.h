@@ -0,0 +1,52 @@
+#ifndef _SURFACE_SCHEDULE_H
+#define _SURFACE_SCHEDULE_H
+
+#include <iostream>
+#include <vector>
+
+#include "op/op.h"
+#include "ode/ode.h"
+
+#include "surface_layer.h"
+
+// A run of consecutive simulated layers fused into one H on a global time axis, layer k on [starts[k], starts[k + 1])
+// The run is one solve: the solver stops at the layer boundaries (critical times) instead of restarting per layer
+// An rz layer is a schedule of its own, applied as before
+class Schedule : public Op {
+public:
+    void diagnose(std::ostream& out, const std::string& indent = "");
+
+    void apply_schedule(State& s, ODESolver* solver);
+
+    void apply(State& out, const State& s, double t) override;
+
+    sz_t size() const { return layers.size(); }
+    // Index of layer k in the layer list
+    sz_t index(sz_t k) const { return indices[k]; }
+    // Layer k of time t (a boundary belongs to the later layer)
+    sz_t layer_at(double t) const;
+
+    bool is_rz() const { return layers[0]->is_rz; }
+    double duration() const { return starts.back(); }
+
+    // fuse: every run of simulated layers becomes one schedule, else one schedule per layer
+    static std::vector<Schedule> compile(std::vector<Layer>& layers, bool fuse = true);
+
+    // No Copy
+    Schedule(const Schedule&) = delete;
+    Schedule& operator=(const Schedule&) = delete;
+
+    // Move
+    Schedule(Schedule&&) = default;
+    Schedule& operator=(Schedule&&) = default;
+
+private:
+    Sys* sys;
+    std::vector<Layer*> layers;
+    std::vector<sz_t> indices;
+    std::vector<double> starts; // [size() + 1]
+
+    Schedule() = default;
+};
+
+#endif // _SURFACE_SCHEDULE_H
@@ -0,0 +1,121 @@
+#include "surface_splitting.h"
+
+#include <bitset>
+#include <limits>
+#include <random>
+
+#include "base/assertion.h"
+
+using std::endl;
+
+// Streams of the clones, apart from the ones of the plain trajectories
+static std::uint64_t clone_stream(std::uint64_t repeat, std::size_t stage, std::size_t clone) {
+    Assert(stage < (1 << 12) && clone < (1 << 20) && repeat < (std::uint64_t(1) << 31));
+    return (std::uint64_t(1) << 63) | (repeat << 32) | (std::uint64_t(stage) << 20) | clone;
+}
+
+void Splitting::parse(nlohmann::json& def) {
+    levels.clear();
+    for (auto& l : def["levels"]) levels.push_back(l.get<sz_t>());
+    for (std::size_t i = 1; i < levels.size(); ++i) {
+        if (levels[i] <= levels[i - 1]) Error("Splitting levels must be increasing");
+    }
+
+    n_per_level = def["n_per_level"].get<std::size_t>();
+    n_cycles = def["n_cycles"].get<sz_t>();
+    if (def.count("n_repeats")) n_repeats = def["n_repeats"].get<std::size_t>();
+
+    Assert(n_per_level > 0 && n_cycles > 0 && n_repeats > 0);
+}
+
+void Splitting::diagnose(std::ostream& out, const std::string& indent) {
+    out << indent << "Levels (syndrome weight): ";
+    for (auto l : levels) out << l << " ";
+    out << endl;
+    out << indent << "Trajectories per level: " << n_per_level << endl;
+    out << indent << "Cycles: " << n_cycles << endl;
+    out << indent << "Repeats: " << n_repeats << endl;
+}
+
+Splitting::Outcome Splitting::advance(Checkpoint& c, sz_t next_level) {
+    while (c.cycle < n_cycles) {
+        if (c.weight >= next_level) return Outcome::Level;
+
+        run.log->emit(Event::Type::Cycle, c.cycle, c.weight);
+
+        while (c.round < run.n_rounds) {
+            sz_t bits = run.extraction_round(c.s, c.round + 1, c.syndromeX, c.syndromeZ);
+            ++c.round;
+            c.weight += std::bitset<64>(bits).count();
+
+            if (c.weight >= next_level) return Outcome::Level;
+        }
+
+        if (run.finish_cycle(c.s, c.syndromeX, c.syndromeZ)) return Outcome::Failure;
+
+        ++c.cycle;
+        c.round = 0;
+        c.syndromeX = Syndrome{};
+        c.syndromeZ = Syndrome{};
+    }
+
+    return Outcome::Survival;
+}
+
+double Splitting::estimate(std::uint64_t repeat) {
+    reach_fractions.clear();
+    fail_fractions.clear();
+
+    std::vector<Checkpoint> entrance(1);
+    entrance[0].s = State{*run.init_state};
+    entrance[0].resumed = true; // Start every stage-0 trajectory on its own stream
+
+    std::uniform_int_distribution<std::size_t> pick;
+    RandomEngine pick_eng{seed, clone_stream(repeat, 0, 0), SurfaceRun::STREAM_SPLITTING};
+
+    double p = 0.;
+    double reach = 1.; // prod_{j < k} r_j
+    for (std::size_t k = 0; k <= levels.size() && !entrance.empty(); ++k) {
+        sz_t next_level = (k < levels.size()) ? levels[k] : std::numeric_limits<sz_t>::max();
+
+        std::vector<Checkpoint> reached;
+        std::size_t n_failed = 0;
+
+        for (std::size_t j = 0; j < n_per_level; ++j) {
+            Checkpoint& from = entrance[pick(pick_eng, decltype(pick)::param_type{0, entrance.size() - 1})];
+
+            Checkpoint c = from;
+            run.begin_trajectory(seed, clone_stream(repeat, k, j));
+            if (!from.resumed) {
+                *run.eng = from.eng;
+                *run.meas_eng = from.meas_eng;
+                from.resumed = true;
+            }
+
+            run.log->emit(Event::Type::SplittingClone, k, repeat, j);
+            switch (advance(c, next_level)) {
+                case Outcome::Level:
+                    c.eng = *run.eng;
+                    c.meas_eng = *run.meas_eng;
+                    c.resumed = false;
+                    reached.push_back(std::move(c));
+                    break;
+                case Outcome::Failure: ++n_failed; break;
+                case Outcome::Survival: break;
+            }
+        }
+
+        double r = (double)reached.size() / n_per_level;
+        double f = (double)n_failed / n_per_level;
+        reach_fractions.push_back(r);
+        fail_fractions.push_back(f);
+
+        run.log->emit(Event::Type::SplittingStage, k, repeat, 0, r, f);
+
+        p += reach * f;
+        reach *= r;
+        entrance = std::move(reached);
+    }
+
+    return p;
+}
@@ -0,0 +1,63 @@
+#ifndef _SURFACE_SPLITTING_H
+#define _SURFACE_SPLITTING_H
+
+#include <vector>
+
+#include "nlohmann/json.hpp"
+
+#include "surface_run.h"
+
+// Fixed-effort multilevel splitting for P(logical error within n_cycles cycles)
+//
+// Importance: accumulated syndrome weight (number of 1 results so far), checked after every round
+// Stage k starts n_per_level trajectories from the states that first reached levels[k - 1] (stage 0: the initial state),
+// each one runs until it reaches levels[k] (saved for stage k + 1), has a logical error, or survives n_cycles
+//
+// P = sum_k (prod_{j < k} r_j) f_k, r_j: fraction reaching the next level, f_k: fraction failing in stage k
+// Entrance states are resampled uniformly, the first clone of a state continues its streams and the others get new ones
+class Splitting {
+public:
+    Splitting(SurfaceRun& run, std::uint64_t seed) : run(run), seed(seed) {}
+
+    // From config "splitting": {"levels": [...], "n_per_level": N, "n_cycles": K, "n_repeats": R}
+    void parse(nlohmann::json& def);
+    void diagnose(std::ostream& out, const std::string& indent = "");
+
+    // One independent estimate of P
+    double estimate(std::uint64_t repeat);
+
+    std::vector<sz_t> levels;
+    std::size_t n_per_level = 100;
+    sz_t n_cycles = 1;
+    std::size_t n_repeats = 1;
+
+    // Of the last estimate
+    std::vector<double> reach_fractions;
+    std::vector<double> fail_fractions;
+
+private:
+    class Checkpoint {
+    public:
+        State s;
+        RandomEngine eng;
+        RandomEngine meas_eng;
+
+        Syndrome syndromeX;
+        Syndrome syndromeZ;
+        sz_t cycle = 0;
+        sz_t round = 0; // Rounds done in this cycle
+        sz_t weight = 0;
+
+        bool resumed = false;
+    };
+
+    enum class Outcome { Level, Failure, Survival };
+
+    // Run c until its weight >= next_level
+    Outcome advance(Checkpoint& c, sz_t next_level);
+
+    SurfaceRun& run;
+    std::uint64_t seed;
+};
+
+#endif // _SURFACE_SPLITTING_H
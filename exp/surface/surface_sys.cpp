@@ -4,7 +4,7 @@
 #include "exp_sop.h"
 #include "exp_lindblad.h"
 
-Sys::Sys(sz_t T_rzx, StatePool& pool, std::mt19937& eng) : T_rzx(T_rzx), unr(nullptr, L, Ldag, sum_LdagL, pool, eng), pool(pool), eng(eng) {}
+Sys::Sys(sz_t T_rzx, StatePool& pool, RandomEngine& eng) : T_rzx(T_rzx), unr(nullptr, L, Ldag, sum_LdagL, pool, eng), pool(pool), eng(eng) {}
 
 Sys::~Sys() {
     for (auto& l : L) delete l;
@@ -12,65 +12,139 @@ Sys::~Sys() {
 }
 
 void Sys::reset_zz_strength(const std::vector<double>& zz_strength) {
+    prefix_cache.clear();
+
     zz_enabled = false;
-    for (std::size_t i = 0; i < topo.size(); ++i) {
-        auto& e = topo[i];
-        auto s = zz_strength[i];
-        if (s) {
-            auto tmp = s * embed(n_qubits, {SSigmaZ, SSigmaZ}, {e.first, e.second});
-            if (!zz_enabled) zz = tmp;
-            else zz += tmp;
-            zz_enabled = true;
+    for (auto s : zz_strength) zz_enabled = zz_enabled || s;
+    if (!zz_enabled) return;
+
+    std::vector<sz_t> edges;
+    for (auto& e : topo) { edges.push_back(e.first); edges.push_back(e.second); }
+
+    zz = shared_sop(ArtifactKey{"zz"}.add(n_qubits).add(edges).add(zz_strength), [&]() {
+        SOp ret;
+        bool first = true;
+        for (std::size_t i = 0; i < topo.size(); ++i) {
+            auto& e = topo[i];
+            auto s = zz_strength[i];
+            if (s) {
+                auto tmp = s * embed(n_qubits, {SSigmaZ, SSigmaZ}, {e.first, e.second});
+                if (first) ret = tmp;
+                else ret += tmp;
+                first = false;
+            }
         }
-    }
+        return ret;
+    });
 }
 
 void Sys::reset_relaxation(const std::vector<double>& T1, const std::vector<double>& T2) {
+    this->T1 = T1;
+    this->T2 = T2;
+
     // Lindblad
     for (auto& l : L) delete l;
     for (auto& ldag : Ldag) delete ldag;
     L.clear(); Ldag.clear();
+    lindblad_info.clear();
     
-    std::vector<SOp> sL;
-    std::vector<SOp> sLdag;
     for (sz_t i = 0; i < n_qubits; ++i) {
         std::vector<Lindblad> Lindblads = relaxation(i, T1[i], T2[i]);
-        std::vector<Lindblad> sLindblads = relaxation_s(T1[i], T2[i]);
 
         for (auto& ld : Lindblads) {
             L.push_back(ld.L);
             Ldag.push_back(ld.Ldag);
         }
 
-        for (auto& sld : sLindblads) {
-            SOp& l = *dynamic_cast<SOp*>(sld.L);
-            SOp& ldag = *dynamic_cast<SOp*>(sld.Ldag);
-
-            sL.push_back(embed(n_qubits, {l}, {i}));
-            sLdag.push_back(embed(n_qubits, {ldag}, {i}));
-
-            delete sld.L;
-            delete sld.Ldag;
-        }
+        // relaxation() gives [Amp, Ph], [Amp] or [Ph]
+        if (T1[i]) lindblad_info.push_back({Channel::Amp, i});
+        if (T2[i]) lindblad_info.push_back({Channel::Ph, i});
     }
 
-    if (!sL.empty()) sum_LdagL = sumLdagL(sL, sLdag);
+    if (!L.empty()) {
+        sum_LdagL = shared_sop(ArtifactKey{"sum_LdagL"}.add(n_qubits).add(T1).add(T2), [&]() {
+            std::vector<SOp> sL;
+            std::vector<SOp> sLdag;
+            for (sz_t i = 0; i < n_qubits; ++i) {
+                for (auto& sld : relaxation_s(T1[i], T2[i])) {
+                    SOp& l = *dynamic_cast<SOp*>(sld.L);
+                    SOp& ldag = *dynamic_cast<SOp*>(sld.Ldag);
+
+                    sL.push_back(embed(n_qubits, {l}, {i}));
+                    sLdag.push_back(embed(n_qubits, {ldag}, {i}));
+
+                    delete sld.L;
+                    delete sld.Ldag;
+                }
+            }
+            return sumLdagL(sL, sLdag);
+        });
+    }
 
     unr.set_lindblads(L, Ldag, sum_LdagL);
 }
 
+// Pure dephasing time of the Ph Lindblad (see relaxation())
+static double T_phi(double T1, double T2) {
+    return T1 ? 1. / (1. / T2 - 1. / 2. / T1) : T2;
+}
+
+std::vector<double> Sys::relaxation_scales(const std::vector<double>& T1, const std::vector<double>& T2) const {
+    Assert(T1.size() == n_qubits && T2.size() == n_qubits);
+    for (sz_t q = 0; q < n_qubits; ++q) {
+        if ((T1[q] && !this->T1[q]) || (T2[q] && !this->T2[q]))
+            Error("Can not reweight to a channel that is not simulated (qubit " << q << ")");
+        if (T1[q] && T2[q] && 2 * T1[q] < T2[q])
+            Error("T2 > 2 T1 (qubit " << q << ")");
+    }
+
+    std::vector<double> scales;
+    for (auto& info : lindblad_info) {
+        sz_t q = info.qubit;
+        if (info.channel == Channel::Amp) {
+            if (!T1[q]) Error("Can not reweight to T1 = 0 (qubit " << q << ")");
+            scales.push_back(this->T1[q] / T1[q]);
+        } else {
+            if (!T2[q]) Error("Can not reweight to T2 = 0 (qubit " << q << ")");
+            scales.push_back(T_phi(this->T1[q], this->T2[q]) / T_phi(T1[q], T2[q]));
+        }
+    }
+    return scales;
+}
+
 void Sys::diagnose(std::ostream& out, const std::string& indent) {
     out << indent << "Type: " << type() << std::endl;
     out << indent << "zz enabled: " << zz_enabled << std::endl;
-    out << indent << "zz dims: [" << zz.matrix().rows() << ", " << zz.matrix().columns() << "] with nnz " << zz.matrix().nonZeros() << std::endl;
+    out << indent << "zz dims: [" << zz.n_rows() << ", " << zz.n_cols() << "] with nnz " << zz.nnz() << (zz.is_view() ? " (shared)" : "") << std::endl;
     out << indent << "#L: " << L.size() << std::endl;
     out << indent << "#Ldag: " << Ldag.size() << std::endl;
-    out << indent << "sum_LdagL dims: [" << sum_LdagL.matrix().rows() << ", " << sum_LdagL.matrix().columns() << "]" << std::endl;
+    out << indent << "sum_LdagL dims: [" << sum_LdagL.n_rows() << ", " << sum_LdagL.n_cols() << "]" << (sum_LdagL.is_view() ? " (shared)" : "") << std::endl;
+}
+
+void Sys::tabulate_pulses(sz_t n_pieces, sz_t degree, std::ostream& out) {
+    std::vector<std::function<double(double)>> single = {
+        [this](double t) { return p_r90(t); },
+        [this](double t) { return p_r180(t); },
+        [this](double t) { return p_id(t); },
+    };
+    std::vector<std::function<double(double)>> zx = {
+        [this](double t) { return p_zx(t); },
+    };
+
+    single_pulses = PulseTable(T_single, single, n_pieces, degree);
+    // T_rzx is T_rzx / T_single times longer, so as many more pieces
+    zx_pulses = PulseTable(T_rzx, zx, n_pieces * (T_rzx / T_single), degree, zx_breaks());
+    use_pulse_tables = true;
+
+    auto err = single_pulses.max_error(single);
+    auto err_zx = zx_pulses.max_error(zx);
+    out << "Pulse tables (" << n_pieces << " pieces / T_single, degree " << degree << ") max error:"
+        << " r90 " << err[PULSE_R90] << ", r180 " << err[PULSE_R180] << ", id " << err[PULSE_ID] << ", zx " << err_zx[0] << std::endl;
 }
 
 /////////////////////////////////////////////////// OptSys
 
-OptSys::OptSys(sz_t T_rzx, double p1, double p2, double p3, StatePool& pool, std::mt19937& eng)
+OptSys::OptSys(sz_t T_rzx, double p1, double p2, double p3, StatePool& pool, RandomEngine& eng)
     : Sys(T_rzx, pool, eng),
       p_zx_0(p1 / (p1 + p2 + p3) * T_rzx),
       p_zx_1(p2 / (p1 + p2 + p3) * T_rzx),
@@ -86,26 +160,22 @@ OptSys::OptSys(sz_t T_rzx, double p1, double p2, double p3, StatePool& pool, std
     _p_id.reset_params(load_vec(id_params_bin).data());
 }
 
-double OptSys::apply_zx(State& out, const State& in, sz_t ctl, sz_t trg, double t) {
-    if (t < p_zx_0.T) {
-        szx.on(ctl, trg).apply(out, in, t);
-        return p_zx_0(t);
-
-    } else if (t < p_zx_0.T + p_zx_1.T) {
-        sx.on(trg).apply(out, in, t);
-        return p_zx_1(t);
+Op& OptSys::zx_op(sz_t ctl, sz_t trg, double t, double phi) {
+    if (t < p_zx_0.T || t >= p_zx_0.T + p_zx_1.T) return zx_on(ctl, trg, phi);
+    else return x_on(trg, phi);
+}
 
-    } else {
-        szx.on(ctl, trg).apply(out, in, t);
-        return p_zx_2(t);
-    }
+double OptSys::p_zx(double t) {
+    if (t < p_zx_0.T) return p_zx_0(t);
+    else if (t < p_zx_0.T + p_zx_1.T) return p_zx_1(t);
+    else return p_zx_2(t);
 }
 
 /////////////////////////////////////////////////// Opt2Sys
 
 SysFactory::Register<Opt2Sys> _reg_opt2_sys;
 
-Opt2Sys::Opt2Sys(sz_t T_rzx, StatePool& pool, std::mt19937& eng)
+Opt2Sys::Opt2Sys(sz_t T_rzx, StatePool& pool, RandomEngine& eng)
     : OptSys(T_rzx, 1., 3., 1., pool, eng) {
 
     constexpr char* zx_params_bin = "./pulse/zx2.bin";
@@ -123,7 +193,7 @@ Opt2Sys::Opt2Sys(sz_t T_rzx, StatePool& pool, std::mt19937& eng)
 
 SysFactory::Register<Opt3Sys> _reg_opt3_sys;
 
-Opt3Sys::Opt3Sys(sz_t T_rzx, StatePool& pool, std::mt19937& eng)
+Opt3Sys::Opt3Sys(sz_t T_rzx, StatePool& pool, RandomEngine& eng)
     : OptSys(T_rzx, 1., 4., 1., pool, eng) {
 
     constexpr char* zx_params_bin = "./pulse/zx3.bin";
@@ -141,8 +211,3 @@ Opt3Sys::Opt3Sys(sz_t T_rzx, StatePool& pool, std::mt19937& eng)
 /////////////////////////////////////////////////// GauSys
 
 SysFactory::Register<GauSys> _reg_gau_sys;
-
-double GauSys::apply_zx(State& out, const State& in, sz_t ctl, sz_t trg, double t) {
-    szx.on(ctl, trg).apply(out, in, t);
-    return _p_zx(t);
-}
@@ -16,6 +16,7 @@
 #include "unraveling/jump.h"
 
 #include "exp_pulse.h"
+#include "exp_artifact.h"
 
 #include "surface_types.h"
 
@@ -40,11 +41,44 @@ public:
 
     void reset_relaxation(const std::vector<double>& T1, const std::vector<double>& T2);
 
+    // What L[k] is
+    enum class Channel { Amp, Ph };
+    class LindbladInfo {
+    public:
+        Channel channel;
+        sz_t qubit;
+    };
+    std::vector<LindbladInfo> lindblad_info;
+    std::vector<double> T1;
+    std::vector<double> T2;
+
+    // Rate of every L[k] at (T1, T2) relative to the current one
+    std::vector<double> relaxation_scales(const std::vector<double>& T1, const std::vector<double>& T2) const;
+
     // Pulse
     virtual double p_r90(double t) = 0;
     virtual double p_r180(double t) = 0;
     virtual double p_id(double t) = 0;
-    virtual double apply_zx(State& out, const State& in, sz_t ctl, sz_t trg, double t) = 0;
+    // The ZX drive at t: its operator (phi: axis of the X on trg, see x_on) and envelope
+    virtual Op& zx_op(sz_t ctl, sz_t trg, double t, double phi) = 0;
+    virtual double p_zx(double t) = 0;
+    // Where the envelope of zx may have kinks
+    virtual std::vector<double> zx_breaks() const { return {}; }
+
+    // out = the ZX drive term at t, returns its envelope
+    double apply_zx(State& out, const State& in, sz_t ctl, sz_t trg, double t, double phi) {
+        zx_op(ctl, trg, t, phi).apply(out, in, t);
+        return p_zx(t);
+    }
+
+    // Pulse tables, interpolants of the envelopes used by the layers instead of the pulses above if enabled
+    enum : sz_t { PULSE_R90 = 0, PULSE_R180 = 1, PULSE_ID = 2 };
+    PulseTable single_pulses; // r90, r180, id on [0, T_single]
+    PulseTable zx_pulses;     // zx on [0, T_rzx]
+    bool use_pulse_tables = false;
+
+    // Builds the tables and enables them, prints their max errors against the pulses
+    void tabulate_pulses(sz_t n_pieces, sz_t degree, std::ostream& out);
 
     static constexpr sz_t T_rz = 0;
     static constexpr sz_t T_single = 1;
@@ -52,6 +86,7 @@ public:
 
     // Evolution
     JumpOpt unr;
+    JumpPrefixCache prefix_cache; // Used by unr if enabled, cleared on every reset
 
     // Hamiltonian terms
     SigmaX sx{0};
@@ -59,16 +94,35 @@ public:
     SigmaZ sz{0};
     SigmaZX szx{0, 0};
 
+    // Drive axis cos(phi) X + sin(phi) Y on q, phi = -(virtual-Z frame of q)
+    PhasedSigmaX psx{0, 0.};
+    PhasedSigmaZX pszx{0, 0, 0.};
+    PrimOp& x_on(sz_t q, double phi) {
+        if (phi == 0.) return sx.on(q);
+        return psx.on(q, phi);
+    }
+    Prim2Op& zx_on(sz_t ctl, sz_t trg, double phi) {
+        if (phi == 0.) return szx.on(ctl, trg);
+        return pszx.on(ctl, trg, phi);
+    }
+
     // Over Rotation
     bool is_over_rotation_enabled = false;
     std::normal_distribution<double> over_rotation_dis;
 
+    // zz, sum_LdagL and the rz of layers from the store if set (views shared by the processes), built otherwise
+    ArtifactStore* artifacts = nullptr;
+    SOp shared_sop(const ArtifactKey& key, const std::function<SOp()>& build) {
+        if (!artifacts) return build();
+        return artifacts->get(key.str(), sz_t(1) << n_qubits, build);
+    }
+
     // Misc
     StatePool& pool;
-    std::mt19937& eng;
+    RandomEngine& eng;
     static constexpr char* type() { return "Sys"; };
 
-    Sys(sz_t T_rzx, StatePool& pool, std::mt19937& eng);
+    Sys(sz_t T_rzx, StatePool& pool, RandomEngine& eng);
 
     virtual ~Sys();
 
@@ -112,11 +166,11 @@ private:
 template<typename... Args>
 std::unordered_map<std::string, typename _SysFactory<Args...>::SysCreateFunc> _SysFactory<Args...>::registry;
 
-using SysFactory = _SysFactory<sz_t, StatePool&, std::mt19937&>;
+using SysFactory = _SysFactory<sz_t, StatePool&, RandomEngine&>;
 
 class OptSys : public Sys {
 public:
-    OptSys(sz_t T_rzx, double p1, double p2, double p3, StatePool& pool, std::mt19937& eng);
+    OptSys(sz_t T_rzx, double p1, double p2, double p3, StatePool& pool, RandomEngine& eng);
     
     // Pulse
     FCos<5> _p_r90{T_single};
@@ -132,24 +186,26 @@ public:
     FCos<5> p_zx_1;
     FCos<1> p_zx_2;
 
-    double apply_zx(State& out, const State& in, sz_t ctl, sz_t trg, double t) override;
+    Op& zx_op(sz_t ctl, sz_t trg, double t, double phi) override;
+    double p_zx(double t) override;
+    std::vector<double> zx_breaks() const override { return {p_zx_0.T, p_zx_0.T + p_zx_1.T}; }
 };
 
 class Opt2Sys : public OptSys {
 public:
-    Opt2Sys(sz_t T_rzx, StatePool& pool, std::mt19937& eng);
+    Opt2Sys(sz_t T_rzx, StatePool& pool, RandomEngine& eng);
     static constexpr char* type() { return "Opt2"; };
 };
 
 class Opt3Sys : public OptSys {
 public:
-    Opt3Sys(sz_t T_rzx, StatePool& pool, std::mt19937& eng);
+    Opt3Sys(sz_t T_rzx, StatePool& pool, RandomEngine& eng);
     static constexpr char* type() { return "Opt3"; };
 };
 
 class GauSys : public Sys {
 public:
-    GauSys(sz_t T_rzx, StatePool& pool, std::mt19937& eng)
+    GauSys(sz_t T_rzx, StatePool& pool, RandomEngine& eng)
         : Sys(T_rzx, pool, eng), _p_zx(T_rzx, T_rzx / 4., M_PI / 2.) {}
     static constexpr char* type() { return "Gau"; };
 
@@ -163,7 +219,8 @@ public:
     double p_id(double t) override { return 0; };
 
     GaussianZero _p_zx;
-    double apply_zx(State& out, const State& in, sz_t ctl, sz_t trg, double t) override;
+    Op& zx_op(sz_t ctl, sz_t trg, double t, double phi) override { return zx_on(ctl, trg, phi); }
+    double p_zx(double t) override { return _p_zx(t); }
 };
 
 #endif // _SURFACE_SYS_H
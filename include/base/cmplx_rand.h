@@ -1,19 +1,37 @@
 #ifndef _CMPLX_RAND_H
 #define _CMPLX_RAND_H
 
-#include <random>
 #include <cmath>
+#include <vector>
 
 #include "base/types.h"
+#include "base/philox.h"
 
+// z ~ CN(0, 1), generated in bulk
 class CNormalRand {
 public:
-    using seed_t = typename std::mt19937::result_type;
-    explicit CNormalRand(seed_t seed) : eng(seed), dis(0.0, M_SQRT1_2) {}
-    Complex operator()() { return Complex{dis(eng), dis(eng)}; }
+    using seed_t = std::uint64_t;
+    explicit CNormalRand(seed_t seed, std::uint64_t stream = 0) : eng(seed, stream), buf(2 * BUF_SIZE), idx(2 * BUF_SIZE) {}
+
+    // Switch to another stream (e.g. per trajectory), dropping the buffered numbers
+    void seed(seed_t seed, std::uint64_t stream = 0) { eng.seed(seed, stream); idx = buf.size(); }
+
+    Complex operator()() {
+        if (idx == buf.size()) {
+            eng.fill_normal(buf.data(), buf.size(), 0.0, M_SQRT1_2);
+            idx = 0;
+        }
+        Complex z{buf[idx], buf[idx + 1]};
+        idx += 2;
+        return z;
+    }
+
 private:
-    std::mt19937 eng;
-    std::normal_distribution<double> dis;
+    static constexpr std::size_t BUF_SIZE = 256;
+
+    RandomEngine eng;
+    std::vector<double> buf;
+    std::size_t idx;
 };
 
-#endif // _CMPLX_RAND_H
\ No newline at end of file
+#endif // _CMPLX_RAND_H
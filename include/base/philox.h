@@ -0,0 +1,134 @@
+#ifndef _PHILOX_H
+#define _PHILOX_H
+
+#include <cstdint>
+#include <array>
+#include <iostream>
+
+// Philox4x32-10 counter-based generator (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3")
+// Output block n of a stream is philox(counter = {n, stream}, key = seed), so
+//  - any (seed, trajectory, purpose) gets its own stream in O(1)
+//  - a stream can be skipped ahead in O(1)
+// Satisfies UniformRandomBitGenerator, so it works with the std distributions.
+class Philox4x32 {
+public:
+    using result_type = std::uint32_t;
+    using ctr_type = std::array<std::uint32_t, 4>;
+    using key_type = std::array<std::uint32_t, 2>;
+
+    static constexpr std::uint64_t default_seed = 5489u;
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return 0xffffffffu; }
+
+    explicit Philox4x32(std::uint64_t seed = default_seed, std::uint64_t trajectory = 0, std::uint32_t purpose = 0) {
+        this->seed(seed, trajectory, purpose);
+    }
+
+    // Counter layout: [block (low 32), block (high 24) | purpose (8), trajectory (low 32), trajectory (high 32)]
+    static constexpr std::uint32_t MAX_PURPOSE = 0xff;
+
+    void seed(std::uint64_t seed, std::uint64_t trajectory = 0, std::uint32_t purpose = 0) {
+        key[0] = static_cast<std::uint32_t>(seed);
+        key[1] = static_cast<std::uint32_t>(seed >> 32);
+
+        ctr[0] = 0;
+        ctr[1] = (purpose & MAX_PURPOSE) << 24;
+        ctr[2] = static_cast<std::uint32_t>(trajectory);
+        ctr[3] = static_cast<std::uint32_t>(trajectory >> 32);
+
+        idx = 4;
+    }
+
+    result_type operator()() {
+        if (idx == 4) {
+            buf = block(ctr, key);
+            next_block();
+            idx = 0;
+        }
+        return buf[idx++];
+    }
+
+    void discard(unsigned long long n) {
+        // Use up the current block, then jump
+        while (n && idx != 4) { ++idx; --n; }
+        skip_blocks(n / 4);
+        for (n %= 4; n; --n) (*this)();
+    }
+
+    // Bulk generation, starting from the next unused block (the rest of the current block is dropped)
+    // out[i] ~ U[0, 1) with 53 random bits
+    void fill_uniform(double* out, std::size_t n);
+    // out[i] ~ N(mean, stddev), Box-Muller
+    void fill_normal(double* out, std::size_t n, double mean = 0., double stddev = 1.);
+
+    // One output block for a given counter and key
+    static ctr_type block(ctr_type c, key_type k) {
+        constexpr std::uint32_t M0 = 0xD2511F53u, M1 = 0xCD9E8D57u;
+        constexpr std::uint32_t W0 = 0x9E3779B9u, W1 = 0xBB67AE85u;
+
+        for (int r = 0; r < 10; ++r) {
+            if (r) { k[0] += W0; k[1] += W1; }
+
+            std::uint64_t p0 = static_cast<std::uint64_t>(M0) * c[0];
+            std::uint64_t p1 = static_cast<std::uint64_t>(M1) * c[2];
+            c = {
+                static_cast<std::uint32_t>(p1 >> 32) ^ c[1] ^ k[0],
+                static_cast<std::uint32_t>(p1),
+                static_cast<std::uint32_t>(p0 >> 32) ^ c[3] ^ k[1],
+                static_cast<std::uint32_t>(p0)
+            };
+        }
+
+        return c;
+    }
+
+    bool operator==(const Philox4x32& o) const {
+        return key == o.key && ctr == o.ctr && idx == o.idx && (idx == 4 || buf == o.buf);
+    }
+    bool operator!=(const Philox4x32& o) const { return !(*this == o); }
+
+    friend std::ostream& operator<<(std::ostream& out, const Philox4x32& e) {
+        return out << e.key[0] << ' ' << e.key[1] << ' '
+                   << e.ctr[0] << ' ' << e.ctr[1] << ' ' << e.ctr[2] << ' ' << e.ctr[3] << ' ' << e.idx;
+    }
+
+    friend std::istream& operator>>(std::istream& in, Philox4x32& e) {
+        in >> e.key[0] >> e.key[1] >> e.ctr[0] >> e.ctr[1] >> e.ctr[2] >> e.ctr[3] >> e.idx;
+        // The buffer is the block before ctr
+        if (e.idx != 4) {
+            Philox4x32 prev = e;
+            prev.skip_blocks(-1);
+            e.buf = block(prev.ctr, e.key);
+        }
+        return in;
+    }
+
+private:
+    key_type key;
+    ctr_type ctr;
+    ctr_type buf;
+    unsigned int idx;
+
+    static constexpr std::uint64_t BLOCK_MASK = (std::uint64_t(1) << 56) - 1;
+
+    std::uint64_t block_index() const {
+        return (static_cast<std::uint64_t>(ctr[1] & 0x00ffffffu) << 32) | ctr[0];
+    }
+
+    void set_block_index(std::uint64_t b) {
+        b &= BLOCK_MASK;
+        ctr[0] = static_cast<std::uint32_t>(b);
+        ctr[1] = (ctr[1] & 0xff000000u) | static_cast<std::uint32_t>(b >> 32);
+    }
+
+    void next_block() { set_block_index(block_index() + 1); }
+    void skip_blocks(std::uint64_t n) { set_block_index(block_index() + n); }
+
+    // out[4 * n_blocks] from the next n_blocks blocks
+    void generate(std::uint32_t* out, std::size_t n_blocks);
+};
+
+using RandomEngine = Philox4x32;
+
+#endif // _PHILOX_H
@@ -0,0 +1,111 @@
+#ifndef _ENSEMBLE_H
+#define _ENSEMBLE_H
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <memory>
+
+#include "base/types.h"
+#include "base/philox.h"
+#include "state/state_pool.h"
+
+// Trajectory ids [0, n) split into one range per worker
+// A worker takes from the front of its own range and steals the back half of another one when empty
+class WorkQueue {
+public:
+    WorkQueue(std::size_t n_workers, std::size_t n_items);
+
+    // false if no work is left anywhere
+    bool next(std::size_t worker, std::size_t& item);
+
+    // Drop all remaining items, next() returns false from then on
+    void cancel();
+    bool is_cancelled() const { return cancelled.load(std::memory_order_acquire); }
+
+private:
+    class alignas(64) Lane {
+    public:
+        std::mutex m;
+        std::size_t begin = 0;
+        std::size_t end = 0;
+    };
+
+    std::vector<Lane> lanes;
+    std::atomic<bool> cancelled{false};
+
+    bool steal(std::size_t worker);
+};
+
+// Per-thread resources, derive to add the solver and the unraveling
+// Everything passed in from outside (operators, tables) is shared and must not be modified by apply
+// (call SOp::prepare before sharing)
+// eng is switched to the stream of each trajectory before it runs, so its result does not depend on the scheduling
+// (with a stop rule, which trajectories finish before the stop does)
+class EnsembleWorker {
+public:
+    using seed_t = std::uint64_t;
+
+    EnsembleWorker(std::size_t id, seed_t seed) : id(id), seed(seed), eng(seed) {}
+    virtual ~EnsembleWorker() = default;
+
+    // No Copy
+    EnsembleWorker(const EnsembleWorker&) = delete;
+    EnsembleWorker& operator=(const EnsembleWorker&) = delete;
+
+    virtual void begin_trajectory(std::size_t traj) { eng.seed(seed, traj); }
+
+    const std::size_t id;
+    const seed_t seed;
+    StatePool pool;
+    RandomEngine eng;
+};
+
+class Ensemble {
+public:
+    explicit Ensemble(std::size_t n_threads = 0)
+        : n_threads(n_threads ? n_threads : std::max(1u, std::thread::hardware_concurrency())) {}
+
+    std::size_t n_workers() const { return n_threads; }
+
+    // make_worker(worker_id) -> std::unique_ptr<Worker>, called on the worker thread
+    // body(Worker&, trajectory_id) for every trajectory_id in [0, n_trajectories)
+    template<typename MakeWorker, typename Body>
+    void run(std::size_t n_trajectories, MakeWorker make_worker, Body body) {
+        run(n_trajectories, std::move(make_worker), std::move(body), [](std::size_t) { return false; });
+    }
+
+    // stop(trajectory_id) -> bool, called (one at a time, under a lock) after each finished trajectory, merge the results there
+    // Returning true drops the trajectories not started yet, the running ones still finish but stop is not called for them
+    template<typename MakeWorker, typename Body, typename Stop>
+    void run(std::size_t n_trajectories, MakeWorker make_worker, Body body, Stop stop) {
+        WorkQueue queue(n_threads, n_trajectories);
+        std::mutex stop_m;
+
+        std::vector<std::thread> threads;
+        threads.reserve(n_threads);
+        for (std::size_t w = 0; w < n_threads; ++w) {
+            threads.emplace_back([&queue, &make_worker, &body, &stop, &stop_m, w]() {
+                auto worker = make_worker(w);
+
+                std::size_t traj;
+                while (queue.next(w, traj)) {
+                    worker->begin_trajectory(traj);
+                    body(*worker, traj);
+
+                    std::lock_guard<std::mutex> lock{stop_m};
+                    if (queue.is_cancelled()) break;
+                    if (stop(traj)) queue.cancel();
+                }
+            });
+        }
+
+        for (auto& t : threads) t.join();
+    }
+
+private:
+    const std::size_t n_threads;
+};
+
+#endif // _ENSEMBLE_H
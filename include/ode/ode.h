@@ -18,6 +18,10 @@ public:
 
     virtual void init_one_step(ODE* ode, const State& psi1, double t1, double t2) = 0;
     virtual double solve_one_step(ODE* ode, State& psi1, double t1, double t2) = 0;
+
+    // solve_one_step never steps across t_crit (init_one_step sets it to its t2), it may be moved on between steps
+    // Only for solvers that may step beyond the t2 of solve_one_step, the others stop at t2 anyway
+    virtual void set_critical_time(double t_crit) {}
 };
 
 #endif // _ODE_SOLVER_H
\ No newline at end of file
@@ -0,0 +1,93 @@
+#ifndef _PLATEN_H
+#define _PLATEN_H
+
+#include <vector>
+#include <limits>
+
+#include "base/cmplx_rand.h"
+#include "ode/sde.h"
+
+// Derivative-free Milstein (Platen) scheme, strong order 1.0 (Kloeden & Platen 11.1.7)
+// Complex noise k is the two real noises 2k, 2k + 1 (b_k / sqrt(2), i b_k / sqrt(2)). In general the scheme needs
+// their double Ito integrals I_(j1, j2): the Levy areas are summed over ceil(levy_factor / h) pieces of the Brownian
+// path, which keeps their error O(h^1.5) per step, and a step costs m (2m + 1) diffusions for m noises.
+// The diffusion of QSD is nonlinear and not holomorphic, so its noise is not commutative, even for a single lindblad.
+// For an SDE with commutative_noise() the areas drop out and a step costs 3m + 1 diffusions.
+class PlatenSolver : public SDESolver {
+public:
+    PlatenSolver(StatePool& pool, CNormalRand& rnd) : pool(pool), rnd(rnd) {}
+
+    void solve(SDE* sde, State& psi1, double t1, double t2) override;
+
+    PlatenSolver& set_step_size(double h) { this->h = h; return *this; }
+    PlatenSolver& set_levy_factor(double levy_factor) { this->levy_factor = levy_factor; return *this; }
+
+    static constexpr double ORDER = 1.0; // Strong
+    static constexpr std::size_t MAX_PIECES = 4096;
+
+protected:
+    double h = 0.01;
+    double levy_factor = 1.0;
+
+    StatePool& pool;
+    CNormalRand& rnd;
+
+    // A piece of the Brownian path [0, h), resolved into pieces for the Levy areas
+    class Segment {
+    public:
+        double h = 0;
+        std::vector<double> dt;   // n_pieces
+        std::vector<Complex> dxi; // n_pieces x n_noises, the increments of every piece
+    };
+
+    // Levy areas are needed for the current sde
+    bool areas = true;
+
+    // Pieces needed for a step of size h
+    std::size_t n_pieces(double h) const;
+
+    // seg = a new piece of the path of size h, dxi_k ~ CN(0, dt) for every piece
+    virtual void draw(Segment& seg, std::size_t n_noises, double h);
+
+    // Split seg at r in (0, seg.h): seg becomes [0, r), the returned one is [r, seg.h)
+    Segment bridge(Segment& seg, double r);
+
+    // Halve the pieces of seg (Brownian bridge) until there are n_pieces(seg.h) of them
+    void refine(Segment& seg);
+
+    // dxi_k = the increments over seg
+    // J[j m + k] = I_(j, 2k) + i I_(j, 2k + 1) for real noise j < 2m, only if areas
+    void integrals(const Segment& seg, std::size_t n_noises, std::vector<Complex>& dxi, std::vector<Complex>& J);
+
+    // yout = one step of size h from (y, t) driven by the increments dxi and the integrals J (empty if !areas)
+    void step(SDE* sde, State& yout, const State& y, double t, double h,
+              const std::vector<Complex>& dxi, const std::vector<Complex>& J);
+};
+
+// Adaptive step size by step doubling
+// Rejected steps are retried on the first half of the same Brownian path (Brownian bridge),
+// the second half is kept and used later, so the sampled path is never thrown away.
+class AdaptivePlatenSolver : public PlatenSolver {
+public:
+    AdaptivePlatenSolver(StatePool& pool, CNormalRand& rnd) : PlatenSolver(pool, rnd) {}
+
+    void solve(SDE* sde, State& psi1, double t1, double t2) override;
+
+    AdaptivePlatenSolver& set_atol(double atol) { this->atol = atol; return *this; }
+    AdaptivePlatenSolver& set_suggested_first_step_size(double h_suggested) { this->h_suggested = h_suggested; return *this; }
+    AdaptivePlatenSolver& set_min_step_size(double h_min) { this->h_min = h_min; return *this; }
+    AdaptivePlatenSolver& set_max_step_size(double h_max) { this->h_max = h_max; return *this; }
+    AdaptivePlatenSolver& set_max_nsteps(std::size_t max_nsteps) { this->max_nsteps = max_nsteps; return *this; }
+
+private:
+    double atol = 1e-4;
+    double h_suggested = 0.01;
+    double h_min = 1e-8;
+    double h_max = std::numeric_limits<double>::infinity();
+    std::size_t max_nsteps = 100000;
+
+    // Future pieces of the Brownian path, the last one is the next
+    std::vector<Segment> pending;
+};
+
+#endif // _PLATEN_H
@@ -0,0 +1,33 @@
+#ifndef _SDE_SOLVER_H
+#define _SDE_SOLVER_H
+
+#include "state/state.h"
+#include "state/state_pool.h"
+
+// d|psi> = a(psi, t) dt + sum_k b_k(psi, t) dxi_k
+// dxi_k: independent complex Wiener increments with E[dxi dxi^*] = dt, E[dxi dxi] = 0
+class SDE {
+public:
+    virtual ~SDE() = default;
+
+    virtual void drift(State& dy, const State& y, double t) = 0;
+
+    virtual std::size_t n_noises() const = 0;
+    virtual void diffusion(State& dy, const State& y, double t, std::size_t k) = 0;
+
+    // L^j b^k = L^k b^j for all real noises j, k (b_k holomorphic and mutually commuting, e.g. linear in y
+    // with commuting operators), solvers may then skip the Levy areas
+    virtual bool commutative_noise() const { return false; }
+
+    // Called after every accepted step, e.g. to renormalize y
+    virtual void on_step(State& y, double t) {}
+};
+
+class SDESolver {
+public:
+    virtual ~SDESolver() = default;
+    // Evolve psi1 according sde from t1 to t2
+    virtual void solve(SDE* sde, State& psi1, double t1, double t2) = 0;
+};
+
+#endif // _SDE_SOLVER_H
@@ -4,6 +4,10 @@
 #include "ode/ode.h"
 #include "zvode/zvode.h"
 
+// Not reentrant: ZVODE keeps its state in COMMON blocks (/ZVOD01/, /ZVOD02/) and SAVE locals,
+// so at most one ZVODESolver of a process may solve at a time (RK45Solver for threads)
+// Block occupancy: ZVODE evaluates the derivative on untracked shadows of its own arrays, so no block is skipped
+// inside a step; psi1 is rescanned after each step and the blocks left all zero are marked empty again
 class ZVODESolver : public ODESolver {
 public:
     explicit ZVODESolver(StatePool& pool) : pool(pool) {}
@@ -11,6 +15,7 @@ public:
     void solve(ODE* ode, State& psi1, double t1, double t2) override;
     void init_one_step(ODE* ode, const State& psi1, double t1, double t2) override;
     double solve_one_step(ODE* ode, State& psi1, double t1, double t2) override;
+    void set_critical_time(double t_crit) override { rwork[0] = t_crit; } // TCRIT of itask 5
 
     enum class Method {
         Adams = 1,
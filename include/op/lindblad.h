@@ -42,6 +42,8 @@ public:
 
     ScaledSigmaZ& on(sz_t the_freedom) { this->the_freedom = the_freedom; return *this; }
 
+    bool is_diagonal() const override { return true; }
+
 protected:
     SCALAR_TYPE scale;
     void apply_inplace(Freedom& v, double t = 0) override {
@@ -0,0 +1,31 @@
+#ifndef _PAULI_H
+#define _PAULI_H
+
+#include <string>
+#include <vector>
+
+#include "op/op.h"
+
+// Pauli string on a qubit state, e.g. "IXYZ" (qubit 0 first)
+//  P |i> = phase (-1)^|i & sign| |i ^ flip>
+class PauliString : public Op {
+public:
+    explicit PauliString(const std::string& paulis);
+
+    void apply(State& out, const State& s, double t) override;
+
+    // <s|P|s> / <s|s>, one pass without a temporary
+    double expectation(const State& s) const;
+    // Of all ps in the same pass
+    static void expectations(std::vector<double>& res, const State& s, const std::vector<const PauliString*>& ps);
+
+    sz_t n_qubits() const { return n; }
+
+private:
+    sz_t n;
+    sz_t flip = 0;
+    sz_t sign = 0;
+    Complex phase = 1.;
+};
+
+#endif // _PAULI_H
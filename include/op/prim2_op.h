@@ -33,6 +33,9 @@ public:
     sz_t the_freedom1;
     sz_t the_freedom2;
 
+    // Maps every basis state to itself, lets block-sparse states keep their occupancy
+    virtual bool is_diagonal() const { return false; }
+
 protected:
     // v = Op(v)
     virtual void apply_inplace(Freedom2& v, double t = 0) = 0;
@@ -82,6 +85,34 @@ protected:
     }
 };
 
+// Z (x) (cos(phi) X + sin(phi) Y)
+class PhasedSigmaZX : public Prim2Op {
+public:
+    PhasedSigmaZX(sz_t the_freedom1, sz_t the_freedom2, double phi) : Prim2Op(the_freedom1, the_freedom2) { set_phi(phi); }
+
+    PhasedSigmaZX& on(sz_t the_freedom1, sz_t the_freedom2, double phi) {
+        this->the_freedom1 = the_freedom1;
+        this->the_freedom2 = the_freedom2;
+        set_phi(phi);
+        return *this;
+    }
+
+protected:
+    Complex e_phi; // exp(i phi)
+
+    void set_phi(double phi) { e_phi = Complex{cos(phi), sin(phi)}; }
+
+    void apply_inplace(Freedom2& v, double t = 0) override {
+        Complex tmp = v(0, 0);
+        v(0, 0) = std::conj(e_phi) * v(0, 1);
+        v(0, 1) = e_phi * tmp;
+
+        tmp = v(1, 0);
+        v(1, 0) = -std::conj(e_phi) * v(1, 1);
+        v(1, 1) = -e_phi * tmp;
+    }
+};
+
 class SigmaZZ : public Prim2Op {
 public:
     SigmaZZ(sz_t the_freedom1, sz_t the_freedom2) : Prim2Op(the_freedom1, the_freedom2) {}
@@ -92,6 +123,8 @@ public:
         return *this;
     }
 
+    bool is_diagonal() const override { return true; }
+
 protected:
     void apply_inplace(Freedom2& v, double t = 0) override {
         v(0, 1) = -v(0, 1);
@@ -31,6 +31,9 @@ public:
 
     sz_t the_freedom;
 
+    // Maps every basis state to itself, lets block-sparse states keep their occupancy
+    virtual bool is_diagonal() const { return false; }
+
 protected:
     // v = Op(v)
     virtual void apply_inplace(Freedom& v, double t = 0) = 0;
@@ -62,12 +65,33 @@ protected:
     }
 };
 
+// cos(phi) X + sin(phi) Y, X rotated by phi about z (a drive in a virtual-Z frame)
+class PhasedSigmaX : public PrimOp {
+public:
+    PhasedSigmaX(sz_t the_freedom, double phi) : PrimOp(the_freedom) { set_phi(phi); }
+
+    PhasedSigmaX& on(sz_t the_freedom, double phi) { this->the_freedom = the_freedom; set_phi(phi); return *this; }
+
+protected:
+    Complex e_phi; // exp(i phi)
+
+    void set_phi(double phi) { e_phi = Complex{cos(phi), sin(phi)}; }
+
+    void apply_inplace(Freedom& v, double t = 0) override {
+        Complex tmp = v(0);
+        v(0) = std::conj(e_phi) * v(1);
+        v(1) = e_phi * tmp;
+    }
+};
+
 class SigmaZ : public PrimOp {
 public:
     explicit SigmaZ(sz_t the_freedom) : PrimOp(the_freedom) {}
 
     SigmaZ& on(sz_t the_freedom) { this->the_freedom = the_freedom; return *this; }
 
+    bool is_diagonal() const override { return true; }
+
 protected:
     void apply_inplace(Freedom& v, double t = 0) override {
         v(1) *= -1.;
@@ -42,6 +42,17 @@ private:
 class SOp: public Op {
 public:
     using MatType = blaze::CompressedMatrix<Complex>;
+
+    // Zero-based CSR arrays
+    class CSR {
+    public:
+        sz_t n_rows = 0;
+        sz_t n_cols = 0;
+        sz_t nnz = 0;
+        const Complex* values = nullptr;  // [nnz]
+        const MKL_INT* columns = nullptr; // [nnz]
+        const MKL_INT* rows = nullptr;    // [n_rows + 1]
+    };
     
     ~SOp();
 
@@ -56,11 +67,17 @@ public:
     static SOp id_like(sz_t n);
     static SOp id_like(const SOp& op);
 
+    // View of CSR arrays owned elsewhere (e.g. a mapped file), not copied: they must outlive the op and its copies
+    // Views are read-only (no arithmetic), matrix() is empty
+    static SOp view(const CSR& csr, SOpProperty prop);
+
     // Copy
     SOp(const SOp& op) { *this = op; }
     SOp& operator=(const SOp& op) {
         mat = op.mat;
         prop = op.prop;
+        is_csr_view = op.is_csr_view;
+        view_csr = op.view_csr;
         is_mkl_inited = false;
 
         return *this;
@@ -71,6 +88,8 @@ public:
     SOp& operator=(SOp&& op) {
         mat = std::move(op.mat);
         prop = std::move(op.prop);
+        is_csr_view = op.is_csr_view;
+        view_csr = op.view_csr;
         is_mkl_inited = false;
 
         return *this;
@@ -89,6 +108,9 @@ public:
     SOp& tensor(const SOp& op);
     friend SOp tensor(const SOp& a, const SOp& b) { return SOp(a).tensor(b); }
 
+    // Build the MKL handle now, apply is then read-only and can be shared between threads
+    void prepare() { init_mkl(); }
+
     void apply(State& out, const State& s, double t) override;
     void axpy_apply(State& out, Complex a, const State& x, double t);
     void axpby_apply(State& out, Complex a, const State& x, Complex b, double t);
@@ -96,11 +118,21 @@ public:
     // Accessor
     const MatType& matrix() const { return mat; }
     const SOpProperty& property() const { return prop; }
+    sz_t n_rows() const { return is_csr_view ? view_csr.n_rows : mat.rows(); }
+    sz_t n_cols() const { return is_csr_view ? view_csr.n_cols : mat.columns(); }
+    sz_t nnz() const { return is_csr_view ? view_csr.nnz : mat.nonZeros(); }
+    bool is_view() const { return is_csr_view; }
+
+    // CSR arrays of the op (built now if needed), valid until it changes
+    CSR csr();
 
 private:
     MatType mat;
     SOpProperty prop;
 
+    bool is_csr_view = false;
+    CSR view_csr;
+
     // For MKL
     bool is_mkl_inited = false;
 
@@ -111,6 +143,7 @@ private:
     std::vector<Complex> values;
     std::vector<MKL_INT> columns;
     std::vector<MKL_INT> rows;
+    const Complex* csr_values() const { return is_csr_view ? view_csr.values : values.data(); }
 };
 
 extern const SOp SSigmaX;
@@ -4,6 +4,7 @@
 #include "base/types.h"
 #include "base/assertion.h"
 #include "base/blas.h"
+#include "base/philox.h"
 #include "base/cmplx_rand.h"
 
 #include "state/state.h"
@@ -14,13 +15,22 @@
 #include "op/prim2_op.h"
 #include "op/sop.h"
 #include "op/lindblad.h"
+#include "op/pauli.h"
 
 #include "ode/ode.h"
 #include "ode/zvode.h"
 #include "ode/rk45.h"
+#include "ode/sde.h"
+#include "ode/platen.h"
 
 #include "unraveling/unraveling.h"
 #include "unraveling/qsd.h"
 #include "unraveling/jump.h"
+#include "unraveling/master.h"
+#include "unraveling/recorder.h"
+
+#include "stats/stats.h"
+
+#include "ensemble/ensemble.h"
 
 #endif // _QE_H
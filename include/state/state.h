@@ -3,9 +3,11 @@
 
 #include <vector>
 #include <cstring>
+#include <cstdint>
 
 #include "base/types.h"
 #include "base/assertion.h"
+#include "base/philox.h"
 
 #include "blaze/math/DynamicVector.h"
 
@@ -26,6 +28,8 @@ public:
     State& operator=(const State& s) {
         Assert(dims == s.dims);
         std::memcpy(data(), s.data(), total_dims() * sizeof(Complex));
+        blk_size = s.blk_size;
+        blk_occupied = s.blk_occupied;
         return *this;
     }
 
@@ -43,6 +47,7 @@ public:
         dims = s.dims;
         skips = s.skips;
         resize_amps(s.total_dims());
+        untrack_blocks();
     }
 
     // Operator
@@ -58,16 +63,61 @@ public:
     State& axpy(Complex a, const State& x); // this += a * x;
     State& axpby(Complex a, const State& x, Complex b); // this = a * x + b * this
 
-    State& operator=(Complex a) { std::fill(begin(), end(), a); return *this; } // fill
+    State& operator=(Complex a) { // fill
+        std::fill(begin(), end(), a);
+        std::fill(blk_occupied.begin(), blk_occupied.end(), a != 0.);
+        return *this;
+    }
 
     // Operation
     Complex inner(const State& s) const; // <this|s>
     double norm() const;
     void normalize();
 
+    // Outcomes of freedoms frees: mixed radix index of their values, frees[0] most significant
+    // Probabilities of the outcomes (normalized)
+    std::vector<double> marginal(const std::vector<sz_t>& frees) const;
+    // n_shots outcomes, without collapsing
+    std::vector<sz_t> sample(const std::vector<sz_t>& frees, std::size_t n_shots, RandomEngine& eng) const;
+    // Keep outcome and renormalize
+    void collapse(const std::vector<sz_t>& frees, sz_t outcome);
+    // Values of frees in outcome
+    std::vector<sz_t> outcome_values(const std::vector<sz_t>& frees, sz_t outcome) const;
+
     // Measure
-    std::vector<sz_t> measure(const std::vector<sz_t>& frees, std::mt19937& eng);
-    sz_t measure2(sz_t qubits, std::mt19937& eng); // qubits: [0, ..., n-1]
+    std::vector<sz_t> measure(const std::vector<sz_t>& frees, RandomEngine& eng);
+    sz_t measure2(sz_t qubits, RandomEngine& eng); // qubits: [0, ..., n-1]
+
+    // Fused measure + reset, two passes in total
+    // Joint outcome of qubits sampled from their marginal probabilities, weight: its norm^2 (one pass)
+    sz_t sample2(sz_t qubits, RandomEngine& eng, double* weight = nullptr) const;
+    // Keep outcome on qubits, flip the qubits in flips (subset of qubits) and renormalize (one pass)
+    // weight: norm^2 of the outcome from sample2, 0: compute it (one more pass)
+    void collapse2(sz_t qubits, sz_t outcome, sz_t flips, double weight = 0);
+    // Measure qubits and reset them to |0>
+    sz_t measure_reset2(sz_t qubits, RandomEngine& eng) {
+        double weight;
+        sz_t outcome = sample2(qubits, eng, &weight);
+        collapse2(qubits, outcome, outcome, weight);
+        return outcome;
+    }
+
+    // Block occupancy (optional)
+    // Blocks of block_size() amplitudes marked empty are all zero, the kernels skip them
+    // Maintained by the State operations, PrimOp / Prim2Op and SOp
+    // Call mark_all_blocks() (or refresh_blocks()) after writing through data()
+    void track_blocks(sz_t block_size = 4096);
+    void untrack_blocks() { blk_size = 0; blk_occupied.clear(); }
+    bool tracks_blocks() const { return !blk_occupied.empty(); }
+    sz_t block_size() const { return tracks_blocks() ? blk_size : total_dims(); }
+    sz_t n_blocks() const { return tracks_blocks() ? blk_occupied.size() : 1; }
+    bool block_occupied(sz_t b) const { return !tracks_blocks() || blk_occupied[b]; }
+    void set_block_occupied(sz_t b, bool occupied) { if (tracks_blocks()) blk_occupied[b] = occupied; }
+    void refresh_blocks();
+    void mark_all_blocks() { std::fill(blk_occupied.begin(), blk_occupied.end(), 1); }
+    void copy_blocks(const State& s) { blk_size = s.blk_size; blk_occupied = s.blk_occupied; } // s has the same size
+    void merge_blocks(const State& s); // Occupied in this or s
+    double occupied_fraction() const;
 
     // Accessor
     Complex* data() { return data_ptr; }
@@ -93,10 +143,20 @@ private:
     std::vector<sz_t> dims;
     std::vector<sz_t> skips;
 
+    // Block occupancy, empty: not tracked
+    sz_t blk_size = 0;
+    std::vector<std::uint8_t> blk_occupied;
+
     // Shadow
     State(Complex* data_ptr, std::vector<sz_t> dims, std::vector<sz_t> skips)
         : data_ptr(data_ptr), shadow_mode(true), dims(std::move(dims)), skips(std::move(skips)) {}
     
+    sz_t sample_basis(double r) const;
+
+    // f(begin, run, outcome) on every run of skip(min free) amplitudes (same outcome of frees), empty blocks skipped
+    template<typename F>
+    void for_runs(const std::vector<sz_t>& frees, F f) const;
+
     // Init
     void init_skips();
     void resize_amps(sz_t n);
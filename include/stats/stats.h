@@ -0,0 +1,163 @@
+#ifndef _STATS_H
+#define _STATS_H
+
+#include <cmath>
+#include <algorithm>
+#include <vector>
+#include <chrono>
+#include <limits>
+#include <string>
+
+#include "base/philox.h"
+
+class Interval {
+public:
+    double lo;
+    double hi;
+
+    double half_width() const { return 0.5 * (hi - lo); }
+};
+
+// z for a two-sided confidence level, e.g. 0.95 -> 1.96
+double normal_quantile_two_sided(double level);
+
+// Running mean / variance (Welford)
+class Welford {
+public:
+    void add(double x) {
+        ++n;
+        double d = x - m;
+        m += d / n;
+        m2 += d * (x - m);
+    }
+
+    // Combine with another accumulator (Chan et al.)
+    void merge(const Welford& o);
+
+    std::size_t count() const { return n; }
+    double mean() const { return m; }
+    double variance() const { return n > 1 ? m2 / (n - 1) : 0.; }
+    double stddev() const { return std::sqrt(variance()); }
+    double sem() const { return n ? std::sqrt(variance() / n) : std::numeric_limits<double>::infinity(); }
+
+    Interval interval(double level = 0.95) const {
+        double hw = normal_quantile_two_sided(level) * sem();
+        return {m - hw, m + hw};
+    }
+
+    // Exact round trip (e.g. checkpoints)
+    friend std::ostream& operator<<(std::ostream& out, const Welford& w);
+    friend std::istream& operator>>(std::istream& in, Welford& w);
+
+private:
+    std::size_t n = 0;
+    double m = 0.;
+    double m2 = 0.;
+};
+
+// Wilson score interval of a binomial proportion
+Interval wilson_interval(std::size_t successes, std::size_t trials, double level = 0.95);
+
+// Percentile bootstrap interval of the mean
+Interval bootstrap_interval(const std::vector<double>& samples, RandomEngine& eng, double level = 0.95, std::size_t n_resamples = 1000);
+
+// Interval of sum(num) / sum(den) over paired samples (delta method)
+Interval ratio_interval(const std::vector<double>& num, const std::vector<double>& den, double level = 0.95);
+
+// Walker alias table, O(1) per draw from a discrete distribution
+class AliasTable {
+public:
+    // weights: unnormalized, not all zero
+    explicit AliasTable(const std::vector<double>& weights);
+
+    std::size_t size() const { return prob.size(); }
+
+    std::size_t sample(RandomEngine& eng) const;
+    // n draws, one uniform each
+    std::vector<std::size_t> sample(RandomEngine& eng, std::size_t n) const;
+
+private:
+    std::vector<double> prob; // Keep column k with prob[k], else alias[k]
+    std::vector<std::size_t> alias;
+
+    std::size_t pick(double u) const {
+        double x = u * prob.size();
+        std::size_t k = std::min(static_cast<std::size_t>(x), prob.size() - 1);
+        return (x - k < prob[k]) ? k : alias[k];
+    }
+};
+
+// Variance of the mean of a correlated series by batched means
+// Keeps at most 2 * n_batches batches, merging neighbours (and doubling the batch size) when full
+class BatchMeans {
+public:
+    explicit BatchMeans(std::size_t n_batches = 32) : n_batches(n_batches) { batches.reserve(2 * n_batches); }
+
+    void add(double x);
+
+    std::size_t count() const { return total.count(); }
+    double mean() const { return total.mean(); }
+    std::size_t batch_size() const { return size; }
+
+    // Standard error of the mean from the complete batches
+    double sem() const;
+
+    Interval interval(double level = 0.95) const {
+        double hw = normal_quantile_two_sided(level) * sem();
+        return {mean() - hw, mean() + hw};
+    }
+
+    // Exact round trip (e.g. checkpoints)
+    friend std::ostream& operator<<(std::ostream& out, const BatchMeans& bm);
+    friend std::istream& operator>>(std::istream& in, BatchMeans& bm);
+
+private:
+    std::size_t n_batches;
+    std::size_t size = 1;
+
+    std::vector<double> batches; // Means of the complete batches
+    double cur_sum = 0.;
+    std::size_t cur_n = 0;
+
+    Welford total;
+};
+
+// When to stop sampling
+// Stops once any of: the relative CI half-width <= rel_ci (never before min_samples), the wall-clock budget is used,
+// max_samples are taken (the last two are hard limits, min_samples does not hold them back)
+class StopRule {
+public:
+    using clock = std::chrono::steady_clock;
+
+    StopRule() : start(clock::now()) {}
+
+    StopRule& set_rel_ci(double rel_ci) { this->rel_ci = rel_ci; return *this; }
+    StopRule& set_time_budget(double seconds) { this->time_budget = seconds; return *this; }
+    StopRule& set_min_samples(std::size_t min_samples) { this->min_samples = min_samples; return *this; }
+    StopRule& set_max_samples(std::size_t max_samples) { this->max_samples = max_samples; return *this; }
+    StopRule& set_level(double level) { this->level = level; return *this; }
+
+    double get_level() const { return level; }
+    bool is_enabled() const { return rel_ci > 0 || time_budget > 0 || max_samples; }
+
+    void restart() { start = clock::now(); stop_reason.clear(); }
+    double elapsed() const { return std::chrono::duration<double>(clock::now() - start).count(); }
+
+    // ci: current interval of the estimate
+    bool should_stop(std::size_t n_samples, double estimate, const Interval& ci);
+
+    // Why should_stop returned true
+    const std::string& reason() const { return stop_reason; }
+
+private:
+    double rel_ci = 0.;      // 0: off
+    double time_budget = 0.; // s, 0: off
+    std::size_t min_samples = 10;
+    std::size_t max_samples = 0; // 0: off
+    double level = 0.95;
+
+    clock::time_point start;
+    std::string stop_reason;
+};
+
+#endif // _STATS_H
@@ -4,9 +4,11 @@
 #include <random>
 
 #include "base/assertion.h"
+#include "base/philox.h"
 #include "op/op.h"
 #include "op/sop.h"
 #include "unraveling/unraveling.h"
+#include "unraveling/jump_cache.h"
 
 class JumpInfo {
 public:
@@ -16,7 +18,7 @@ public:
 
 class Jump : public Unraveling {
 public:
-    Jump(Op* H, std::vector<Op*> L, std::vector<Op*> Ldag, StatePool& pool, std::mt19937& eng)
+    Jump(Op* H, std::vector<Op*> L, std::vector<Op*> Ldag, StatePool& pool, RandomEngine& eng)
         : pool(pool), eng(eng), rnd(0.0, 1.0) {
         set_H(H);
         set_lindblads(std::move(L), std::move(Ldag));
@@ -36,12 +38,49 @@ public:
     void set_max_norm_nsteps(std::size_t max_norm_nsteps) { this->max_norm_nsteps = max_norm_nsteps; }
 
     void set_H(Op* H) { this->H = H; }
+
+    // Times where H is not smooth (sorted), every solve stops at the ones inside (critical times) instead of stepping across
+    // The solver keeps its history there, cheaper than one solve per smooth piece
+    void set_breakpoints(std::vector<double> breakpoints) { this->breakpoints = std::move(breakpoints); }
     void set_lindblads(std::vector<Op*> L, std::vector<Op*> Ldag) {
         Assert(L.size() == Ldag.size());
         this->L = std::move(L); this->Ldag = std::move(Ldag);
         cum_probs.resize(this->L.size());
+        if (prefix_cache) prefix_cache->clear();
+        clear_statistics();
+    }
+
+    // Reuse the no-jump evolutions of earlier solves (nullptr: off)
+    // Only if H is deterministic, tag must change with anything else the evolution depends on
+    // Not used while an observable recorder is set
+    void set_prefix_cache(JumpPrefixCache* prefix_cache, std::uint64_t tag = 0) {
+        this->prefix_cache = prefix_cache;
+        this->prefix_tag = tag;
+    }
+
+    // Sufficient statistics for reweighting to other rates, accumulated over solves until cleared
+    //  I_k = int <L_k^ L_k> dt (normalized state, trapezoid over the accepted steps), n_k = #jumps by L_k
+    // Recording costs one L_k apply per step and disables the prefix cache
+    void set_record_statistics(bool record_statistics) { this->record_statistics = record_statistics; }
+    const std::vector<double>& integrated_populations() const { return integrated_pops; }
+    const std::vector<std::size_t>& jump_counts() const { return n_jumps; }
+    // Restore recorded statistics (e.g. from a checkpoint)
+    void set_statistics(std::vector<double> integrated_pops, std::vector<std::size_t> n_jumps) {
+        Assert(integrated_pops.size() == L.size() && n_jumps.size() == L.size());
+        this->integrated_pops = std::move(integrated_pops);
+        this->n_jumps = std::move(n_jumps);
+    }
+    void clear_statistics() {
+        integrated_pops.assign(L.size(), 0.);
+        n_jumps.assign(L.size(), 0);
     }
 
+    // log of the likelihood ratio of the recorded statistics when every L_k is scaled to sqrt(scales[k]) L_k
+    //  w = prod_k scales[k]^n_k exp(-(scales[k] - 1) I_k)
+    // Frozen-population approximation: exact for the jump record, the change of the no-jump path itself
+    // (through the normalized populations) is neglected, so only use it for nearby rates
+    double log_likelihood_ratio(const std::vector<double>& scales) const;
+
     void new_trajectory() override {
         target_norm2 = rnd(eng);
         clear_jumps();
@@ -54,7 +93,7 @@ protected:
 
     StatePool& pool;
 
-    std::mt19937& eng;
+    RandomEngine& eng;
     std::uniform_real_distribution<double> rnd;
 
     void locate_jump_time(State& psi_prev, double t_prev, double norm2_prev, State& psi, double& t, double norm2_now, double target_norm2, ODESolver* solver);
@@ -64,14 +103,31 @@ protected:
     
     void jump(State& psi, double t);
     double target_norm2;
+
+    // Returns true if jumped, recorder (if any) gets the evolution if not
+    bool evolve(ODESolver* solver, State& psi, double t1, double t2, double target_norm2, JumpPrefixCache::Recorder* recorder);
+
+    bool record_statistics = false;
+    std::vector<double> integrated_pops;
+    std::vector<std::size_t> n_jumps;
+    void populations(std::vector<double>& pops, const State& psi, double t);
+
+    JumpPrefixCache* prefix_cache = nullptr;
+    std::uint64_t prefix_tag = 0;
+    // Continue a cached evolution, returns true (psi jumped at t) if the target is reached before t2
+    bool replay(const JumpPrefixCache::Entry& entry, ODESolver* solver, State& psi, double& t, double target_norm2);
     std::vector<double> cum_probs;
 
     std::vector<JumpInfo> jump_info;
+
+    std::vector<double> breakpoints;
+    // First breakpoint after t, t2 if none
+    double next_breakpoint(double t, double t2) const;
 };
 
 class JumpOpt : public Jump {
 public:
-    JumpOpt(Op* H, std::vector<Op*> L, std::vector<Op*> Ldag, SOp sum_LdagL, StatePool& pool, std::mt19937& eng) : Jump(H, std::move(L), std::move(Ldag), pool, eng), sum_LdagL(std::move(sum_LdagL)) {}
+    JumpOpt(Op* H, std::vector<Op*> L, std::vector<Op*> Ldag, SOp sum_LdagL, StatePool& pool, RandomEngine& eng) : Jump(H, std::move(L), std::move(Ldag), pool, eng), sum_LdagL(std::move(sum_LdagL)) {}
 
     void derivative(State& dy, const State& y, double t) override;
 
@@ -0,0 +1,100 @@
+#ifndef _JUMP_CACHE_H
+#define _JUMP_CACHE_H
+
+#include <cstdint>
+#include <vector>
+#include <list>
+#include <unordered_map>
+
+#include "state/state.h"
+#include "op/op.h"
+#include "base/assertion.h"
+
+// No-jump evolutions shared by many trajectories
+// Key: (input state, H, [t1, t2], tag), the tag tells apart anything else the evolution depends on (e.g. the Lindblads)
+// Value: the norm^2 curve at every accepted step and a bounded number of checkpoints of the (unnormalized) state
+// Only valid while H and the Lindblads are deterministic functions of the key (e.g. no over rotation)
+// Bounded by entries and by bytes (the oldest entries go first), an entry larger than max_bytes is not kept
+class JumpPrefixCache {
+public:
+    class Point {
+    public:
+        double t;
+        double norm2;
+    };
+
+    class Checkpoint {
+    public:
+        double t;
+        double norm2;
+        State psi;
+    };
+
+    class Entry {
+    public:
+        const Op* H;
+        double t1;
+        double t2;
+        std::uint64_t tag;
+
+        std::vector<Point> curve; // Every accepted step, curve[0] is t1
+        std::vector<Checkpoint> checkpoints; // checkpoints[0] is the input state at t1
+        State final_psi; // Normalized state at t2
+
+        // Last checkpoint at or before t
+        const Checkpoint& checkpoint_before(double t) const;
+    };
+
+    explicit JumpPrefixCache(std::size_t max_entries = 64, std::size_t max_checkpoints = 8, std::size_t max_bytes = 256ull << 20)
+        : max_entries(max_entries), max_checkpoints(max_checkpoints), max_bytes(max_bytes) { Assert(max_checkpoints >= 2); }
+
+    JumpPrefixCache& set_max_entries(std::size_t max_entries) { this->max_entries = max_entries; return *this; }
+    JumpPrefixCache& set_max_bytes(std::size_t max_bytes) { this->max_bytes = max_bytes; return *this; }
+
+    // nullptr if not cached
+    const Entry* find(const State& psi, const Op* H, double t1, double t2, std::uint64_t tag);
+
+    // Recording of a new entry, call record() after every accepted step and then commit()
+    class Recorder {
+    public:
+        void record(double t, double norm2, const State& psi);
+        void commit(const State& final_psi);
+
+    private:
+        friend class JumpPrefixCache;
+        Recorder(JumpPrefixCache& cache, std::uint64_t key, const State& psi, const Op* H, double t1, double t2, std::uint64_t tag);
+
+        JumpPrefixCache& cache;
+        std::uint64_t key;
+        Entry entry;
+        std::size_t stride = 1;
+        std::size_t n_steps = 0;
+    };
+    Recorder start(const State& psi, const Op* H, double t1, double t2, std::uint64_t tag);
+
+    void clear() { entries.clear(); order.clear(); n_bytes = 0; }
+
+    std::size_t n_hits() const { return hits; }
+    std::size_t n_misses() const { return misses; }
+    std::size_t bytes() const { return n_bytes; }
+
+    static std::uint64_t fingerprint(const State& psi);
+
+private:
+    std::size_t max_entries;
+    std::size_t max_checkpoints;
+    std::size_t max_bytes;
+
+    std::unordered_map<std::uint64_t, Entry> entries;
+    std::list<std::uint64_t> order; // Insertion order, oldest first
+    std::size_t n_bytes = 0; // Of the states and curves of all entries
+
+    std::size_t hits = 0;
+    std::size_t misses = 0;
+
+    static std::uint64_t make_key(const State& psi, const Op* H, double t1, double t2, std::uint64_t tag);
+    void insert(std::uint64_t key, Entry entry);
+    static std::size_t entry_bytes(const Entry& entry);
+};
+
+#endif // _JUMP_CACHE_H
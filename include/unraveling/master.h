@@ -0,0 +1,62 @@
+#ifndef _MASTER_H
+#define _MASTER_H
+
+#include <vector>
+
+#include "base/assertion.h"
+#include "state/state_pool.h"
+#include "op/op.h"
+#include "op/sop.h"
+#include "ode/ode.h"
+
+// Lindblad master equation on a vectorized density matrix
+//  d rho / dt = K rho + (K rho)^ + sum_k L_k (L_k rho)^,  K = -i H - 1/2 sum_k L_k^ L_k
+// rho: State of dims [d_0, ..., d_{n-1}, d_0, ..., d_{n-1}], row-major (row freedoms first)
+// H, L, Ldag only act on the row freedoms: PrimOp / Prim2Op on [0, n) work as they are, SOp via row_op()
+// (rho L^ = (L rho)^ as rho is hermitian, so no column operators are needed)
+class MasterEquation : public ODE {
+public:
+    MasterEquation(Op* H, std::vector<Op*> L, std::vector<Op*> Ldag, StatePool& pool) : H(H), pool(pool) {
+        set_lindblads(std::move(L), std::move(Ldag));
+    }
+
+    void set_H(Op* H) { this->H = H; }
+    void set_lindblads(std::vector<Op*> L, std::vector<Op*> Ldag) {
+        Assert(L.size() == Ldag.size());
+        this->L = std::move(L); this->Ldag = std::move(Ldag);
+    }
+    std::size_t n_lindblads() const { return L.size(); }
+
+    void derivative(State& drho, const State& rho, double t) override;
+
+    // Evolve rho from t1 to t2 and renormalize
+    // The solver's pool must not hold states of the same size but other dims (e.g. a state of 2n qubits)
+    void solve(ODESolver* solver, State& rho, double t1, double t2) {
+        solver->solve(this, rho, t1, t2);
+        renormalize(rho);
+    }
+
+    // |psi><psi|
+    static State density_matrix(const State& psi);
+
+    static Complex trace(const State& rho);
+    // out = rho^
+    static void dagger(State& out, const State& rho);
+    // rho = (rho + rho^) / 2 / tr
+    static void renormalize(State& rho);
+
+    // tr(A rho), A on the row freedoms
+    Complex expectation(Op* A, const State& rho, double t = 0);
+
+    // op (x) I for an SOp on the system
+    static SOp row_op(const SOp& op) { return tensor(op, SOp::id_like(op)); }
+
+private:
+    Op* H;
+    std::vector<Op*> L;
+    std::vector<Op*> Ldag;
+
+    StatePool& pool;
+};
+
+#endif // _MASTER_H
@@ -6,9 +6,10 @@
 #include "state/state_pool.h"
 #include "op/op.h"
 #include "op/sop.h"
+#include "ode/sde.h"
 #include "unraveling/unraveling.h"
 
-class QSD : public Unraveling {
+class QSD : public Unraveling, public SDE {
 public:
     QSD(Op* H, std::vector<Op*> L, std::vector<Op*> Ldag, StatePool& pool, CNormalRand& rnd)
         : pool(pool), rnd(rnd) {
@@ -18,10 +19,19 @@ public:
 
     std::size_t n_lindblads() const { return L.size(); }
 
+    // With an SDE solver set, solver is not used
     void solve(ODESolver* solver, State& psi1, double t1, double t2) override;
     void derivative(State& dy, const State& y, double t) override;
 
+    // SDE
+    void drift(State& dy, const State& y, double t) override { derivative(dy, y, t); }
+    std::size_t n_noises() const override { return n_lindblads(); }
+    void diffusion(State& dy, const State& y, double t, std::size_t k) override;
+    void on_step(State& y, double t) override { y.normalize(); }
+
     void set_stochastic_step_size(double h_stoch) { this->h_stoch = h_stoch; }
+    // Evolve drift and diffusion together with sde_solver instead of splitting
+    void set_sde_solver(SDESolver* sde_solver) { this->sde_solver = sde_solver; }
 
     void set_H(Op* H) { this->H = H; }
     void set_lindblads(std::vector<Op*> L, std::vector<Op*> Ldag) {
@@ -33,6 +43,7 @@ public:
 
 protected:
     double h_stoch = 0.01;
+    SDESolver* sde_solver = nullptr;
 
     Op* H;
     std::vector<Op*> L;
@@ -0,0 +1,134 @@
+#ifndef _RECORDER_H
+#define _RECORDER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+#include "state/state.h"
+#include "state/state_pool.h"
+#include "op/op.h"
+#include "op/pauli.h"
+
+// Time traces of observables during Unraveling::solve, from the accepted steps (no extra integration)
+// Values at the requested times are interpolated linearly between the ends of the step containing them
+// Rows go into preallocated columnar buffers, full buffers are handed to the sink on a background thread
+// One recorder per Unraveling (i.e. per worker thread)
+class ObservableRecorder {
+public:
+    class Columns {
+    public:
+        std::vector<double> t;
+        std::vector<std::uint64_t> traj;
+        std::vector<std::vector<double>> values; // values[observable][row]
+
+        std::size_t size() const { return t.size(); }
+        void clear() {
+            t.clear(); traj.clear();
+            for (auto& v : values) v.clear();
+        }
+    };
+
+    // Called on the background thread, one buffer at a time
+    using Sink = std::function<void(const std::vector<std::string>& names, const Columns& rows)>;
+
+    explicit ObservableRecorder(std::size_t capacity = 4096) : capacity(capacity) { Assert(capacity > 0); }
+    ~ObservableRecorder();
+
+    // No Copy
+    ObservableRecorder(const ObservableRecorder&) = delete;
+    ObservableRecorder& operator=(const ObservableRecorder&) = delete;
+
+    // Observables, Re <psi|O|psi> / <psi|psi>
+    void add_op(std::string name, Op* op);
+    void add_pauli(std::string name, const std::string& pauli); // "IXYZ", qubit 0 first
+    void add_projector(std::string name, std::vector<sz_t> frees, sz_t outcome); // Probability of outcome (State::marginal)
+
+    const std::vector<std::string>& names() const { return obs_names; }
+    std::size_t n_observables() const { return obs_names.size(); }
+
+    // Output times (in trajectory time, sorted), empty: every accepted step
+    void set_times(std::vector<double> times) { this->times = std::move(times); }
+    // Trajectory time = solve time + offset (e.g. the cycle, when every cycle is solved from 0)
+    void set_time_offset(double offset) { this->offset = offset; }
+
+    // Without a sink, the rows are kept in memory (collected())
+    void set_sink(Sink sink) { this->sink = std::move(sink); }
+    const Columns& collected() const { return kept; }
+
+    void begin_trajectory(std::uint64_t traj);
+
+    // From the unraveling
+    // An output time in [t_prev, t]
+    bool wants(double t_prev, double t) const;
+    // Values at t_prev, before psi_prev is changed (e.g. by locating a jump)
+    void mark(const State& psi_prev, double t_prev, StatePool& pool);
+    // Accepted step psi_prev (t_prev) -> psi (t) without a jump in between
+    void on_step(const State& psi_prev, double t_prev, const State& psi, double t, StatePool& pool);
+    // psi jumped, the values at the last step end are stale
+    void discontinuity() { last_valid = false; }
+
+    // Hand the current buffer to the sink, wait(): until the sink has written everything
+    void flush();
+    void wait();
+
+    // Rows as CSV: t, traj, observables...
+    static Sink csv_sink(std::ostream& out);
+
+private:
+    class Observable {
+    public:
+        Op* op = nullptr;
+        std::unique_ptr<PauliString> pauli;
+        std::vector<sz_t> frees;
+        sz_t outcome = 0;
+    };
+
+    std::vector<std::string> obs_names;
+    std::vector<Observable> obs;
+
+    // The Pauli observables, evaluated together in one pass
+    std::vector<const PauliString*> paulis;
+    std::vector<std::size_t> pauli_obs; // Index in obs
+    std::vector<double> pauli_values;
+
+    std::vector<double> times;
+    std::size_t cursor = 0;
+    double offset = 0.;
+    std::uint64_t traj = 0;
+
+    // Values at the end of the last step
+    bool last_valid = false;
+    double last_t = 0.;
+    std::vector<double> last_values;
+    std::vector<double> cur_values;
+
+    void evaluate(std::vector<double>& values, const State& psi, double t, StatePool& pool);
+    void push_row(double t, const std::vector<double>& a, const std::vector<double>& b, double w);
+
+    // Buffers
+    std::size_t capacity;
+    Columns buffer;
+    Columns kept;
+    Sink sink;
+    Columns new_columns() const;
+
+    // Background flush
+    std::mutex m;
+    std::condition_variable cv;
+    std::deque<Columns> full;
+    std::vector<Columns> spare;
+    bool busy = false;
+    bool stopping = false;
+    std::thread flusher;
+    void flush_loop();
+};
+
+#endif // _RECORDER_H
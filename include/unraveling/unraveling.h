@@ -4,6 +4,8 @@
 #include "state/state.h"
 #include "ode/ode.h"
 
+class ObservableRecorder;
+
 class Unraveling : public ODE {
 public:
     virtual ~Unraveling() = default;
@@ -11,6 +13,12 @@ public:
     virtual void solve(ODESolver* solver, State& psi1, double t1, double t2) = 0;
     
     virtual void new_trajectory() = 0;
+
+    // Time traces of observables during solve (nullptr: off)
+    void set_observable_recorder(ObservableRecorder* obs_recorder) { this->obs_recorder = obs_recorder; }
+
+protected:
+    ObservableRecorder* obs_recorder = nullptr;
 };
 
 #endif // _UNRAVELING_H
\ No newline at end of file
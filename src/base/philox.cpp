@@ -0,0 +1,86 @@
+#include "base/philox.h"
+
+#include <cmath>
+
+// Blocks computed together, the round loops below run over the batch so they vectorize
+constexpr std::size_t BATCH = 16;
+
+void Philox4x32::generate(std::uint32_t* out, std::size_t n_blocks) {
+    constexpr std::uint32_t M0 = 0xD2511F53u, M1 = 0xCD9E8D57u;
+    constexpr std::uint32_t W0 = 0x9E3779B9u, W1 = 0xBB67AE85u;
+
+    std::uint32_t c0[BATCH] = {}, c1[BATCH] = {}, c2[BATCH] = {}, c3[BATCH] = {};
+
+    for (std::size_t b0 = 0; b0 < n_blocks; b0 += BATCH) {
+        std::size_t nb = (n_blocks - b0 < BATCH) ? n_blocks - b0 : BATCH;
+
+        for (std::size_t j = 0; j < nb; ++j) {
+            std::uint64_t b = (block_index() + j) & BLOCK_MASK;
+            c0[j] = static_cast<std::uint32_t>(b);
+            c1[j] = (ctr[1] & 0xff000000u) | static_cast<std::uint32_t>(b >> 32);
+            c2[j] = ctr[2];
+            c3[j] = ctr[3];
+        }
+
+        std::uint32_t k0 = key[0], k1 = key[1];
+        for (int r = 0; r < 10; ++r) {
+            if (r) { k0 += W0; k1 += W1; }
+
+            for (std::size_t j = 0; j < BATCH; ++j) {
+                std::uint64_t p0 = static_cast<std::uint64_t>(M0) * c0[j];
+                std::uint64_t p1 = static_cast<std::uint64_t>(M1) * c2[j];
+                std::uint32_t n0 = static_cast<std::uint32_t>(p1 >> 32) ^ c1[j] ^ k0;
+                std::uint32_t n2 = static_cast<std::uint32_t>(p0 >> 32) ^ c3[j] ^ k1;
+                c0[j] = n0;
+                c1[j] = static_cast<std::uint32_t>(p1);
+                c2[j] = n2;
+                c3[j] = static_cast<std::uint32_t>(p0);
+            }
+        }
+
+        for (std::size_t j = 0; j < nb; ++j) {
+            out[4 * (b0 + j) + 0] = c0[j];
+            out[4 * (b0 + j) + 1] = c1[j];
+            out[4 * (b0 + j) + 2] = c2[j];
+            out[4 * (b0 + j) + 3] = c3[j];
+        }
+
+        skip_blocks(nb);
+    }
+}
+
+void Philox4x32::fill_uniform(double* out, std::size_t n) {
+    idx = 4;
+
+    // Two 32-bit words -> 53-bit double, one block -> two doubles
+    std::uint32_t words[4 * BATCH];
+    for (std::size_t i0 = 0; i0 < n; i0 += 2 * BATCH) {
+        std::size_t m = (n - i0 < 2 * BATCH) ? n - i0 : 2 * BATCH;
+        generate(words, (m + 1) / 2);
+
+        for (std::size_t i = 0; i < m; ++i) {
+            std::uint64_t a = words[2 * i] >> 5;
+            std::uint64_t b = words[2 * i + 1] >> 6;
+            out[i0 + i] = static_cast<double>((a << 26) | b) * (1.0 / 9007199254740992.0); // 2^-53
+        }
+    }
+}
+
+void Philox4x32::fill_normal(double* out, std::size_t n, double mean, double stddev) {
+    // Uniform pairs, then transformed in place
+    std::size_t n_even = n & ~std::size_t(1);
+    fill_uniform(out, n_even);
+
+    for (std::size_t i = 0; i < n_even; i += 2) {
+        double r = stddev * std::sqrt(-2. * std::log(1. - out[i])); // 1 - u in (0, 1]
+        double theta = 2. * M_PI * out[i + 1];
+        out[i] = mean + r * std::cos(theta);
+        out[i + 1] = mean + r * std::sin(theta);
+    }
+
+    if (n_even != n) {
+        double tail[2];
+        fill_normal(tail, 2, mean, stddev);
+        out[n_even] = tail[0];
+    }
+}
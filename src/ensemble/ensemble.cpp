@@ -0,0 +1,55 @@
+#include "ensemble/ensemble.h"
+
+WorkQueue::WorkQueue(std::size_t n_workers, std::size_t n_items) : lanes(n_workers) {
+    for (std::size_t w = 0; w < n_workers; ++w) {
+        lanes[w].begin = n_items * w / n_workers;
+        lanes[w].end = n_items * (w + 1) / n_workers;
+    }
+}
+
+bool WorkQueue::next(std::size_t worker, std::size_t& item) {
+    while (!is_cancelled()) {
+        {
+            Lane& lane = lanes[worker];
+            std::lock_guard<std::mutex> lock{lane.m};
+            if (lane.begin < lane.end) {
+                item = lane.begin++;
+                return true;
+            }
+        }
+
+        if (!steal(worker)) return false;
+    }
+    return false;
+}
+
+bool WorkQueue::steal(std::size_t worker) {
+    for (std::size_t i = 1; i < lanes.size(); ++i) {
+        Lane& victim = lanes[(worker + i) % lanes.size()];
+        Lane& lane = lanes[worker];
+
+        // Both locks: the range is never outside a lane, where cancel() would miss it
+        std::unique_lock<std::mutex> lock_victim{victim.m, std::defer_lock};
+        std::unique_lock<std::mutex> lock_lane{lane.m, std::defer_lock};
+        std::lock(lock_victim, lock_lane);
+
+        std::size_t left = victim.end - victim.begin;
+        if (left == 0) continue;
+
+        // Take the back half (at least one)
+        lane.end = victim.end;
+        lane.begin = victim.end - (left + 1) / 2;
+        victim.end = lane.begin;
+        return true;
+    }
+
+    return false;
+}
+
+void WorkQueue::cancel() {
+    cancelled.store(true, std::memory_order_release);
+    for (auto& lane : lanes) {
+        std::lock_guard<std::mutex> lock{lane.m};
+        lane.begin = lane.end;
+    }
+}
@@ -0,0 +1,382 @@
+#include "ode/platen.h"
+
+#include <cmath>
+#include <algorithm>
+
+constexpr double PlatenSolver::ORDER;
+constexpr std::size_t PlatenSolver::MAX_PIECES;
+
+constexpr double SAFETY = 0.9;
+constexpr double PGROW = -1. / (PlatenSolver::ORDER + 0.5); // Local error ~ h^(ORDER + 1/2)
+constexpr double MAX_GROW = 2.0;
+
+// PlatenSolver
+
+std::size_t PlatenSolver::n_pieces(double h) const {
+    if (!areas) return 1;
+
+    double n = std::ceil(levy_factor / h);
+    if (n >= MAX_PIECES) return MAX_PIECES;
+    return std::max(std::size_t(n), std::size_t(1));
+}
+
+void PlatenSolver::draw(Segment& seg, std::size_t n_noises, double h) {
+    std::size_t n = n_pieces(h);
+    double dt = h / n;
+    double sqrt_dt = std::sqrt(dt);
+
+    seg.h = h;
+    seg.dt.assign(n, dt);
+    seg.dxi.resize(n * n_noises);
+    for (auto& x : seg.dxi) x = sqrt_dt * rnd();
+}
+
+PlatenSolver::Segment PlatenSolver::bridge(Segment& seg, double r) {
+    Assert(r > 0 && r < seg.h);
+
+    const std::size_t m = seg.dxi.size() / seg.dt.size();
+    const double eps = 1e-12 * seg.h;
+
+    // Piece l contains r
+    std::size_t l = 0;
+    double s = 0;
+    while (l + 1 < seg.dt.size() && s + seg.dt[l] <= r + eps) s += seg.dt[l++];
+    double off = r - s;
+
+    Segment tail;
+    tail.h = seg.h - r;
+
+    if (off <= eps && l > 0) {
+        // r is on the border of piece l
+        tail.dt.assign(seg.dt.begin() + l, seg.dt.end());
+        tail.dxi.assign(seg.dxi.begin() + l * m, seg.dxi.end());
+
+    } else {
+        // W(off) | W(dt) = d ~ CN(off / dt * d, off (dt - off) / dt)
+        double dt = seg.dt[l];
+        off = std::min(std::max(off, eps), dt - eps);
+        double mean = off / dt;
+        double sd = std::sqrt(off * (dt - off) / dt);
+
+        tail.dt.assign(seg.dt.begin() + l, seg.dt.end());
+        tail.dt[0] = dt - off;
+        tail.dxi.assign(seg.dxi.begin() + l * m, seg.dxi.end());
+        for (std::size_t k = 0; k < m; ++k) {
+            Complex head = mean * seg.dxi[l * m + k] + sd * rnd();
+            tail.dxi[k] -= head;
+            seg.dxi[l * m + k] = head;
+        }
+        seg.dt[l] = off;
+        ++l;
+    }
+
+    seg.dt.resize(l);
+    seg.dxi.resize(l * m);
+    seg.h = r;
+
+    return tail;
+}
+
+void PlatenSolver::refine(Segment& seg) {
+    const std::size_t m = seg.dxi.size() / seg.dt.size();
+    const double max_dt = seg.h / n_pieces(seg.h) * (1 + 1e-9);
+
+    std::vector<double> dt;
+    std::vector<Complex> dxi;
+    for (bool split = true; split;) {
+        split = false;
+        dt.clear();
+        dxi.clear();
+
+        for (std::size_t l = 0; l < seg.dt.size(); ++l) {
+            const Complex* d = &seg.dxi[l * m];
+            if (seg.dt[l] <= max_dt) {
+                dt.push_back(seg.dt[l]);
+                dxi.insert(dxi.end(), d, d + m);
+                continue;
+            }
+
+            // W(dt / 2) | W(dt) = d ~ CN(d / 2, dt / 4)
+            double sd = std::sqrt(0.25 * seg.dt[l]);
+            std::size_t head = dxi.size();
+            for (std::size_t k = 0; k < m; ++k) dxi.push_back(0.5 * d[k] + sd * rnd());
+            for (std::size_t k = 0; k < m; ++k) dxi.push_back(d[k] - dxi[head + k]);
+            dt.push_back(0.5 * seg.dt[l]);
+            dt.push_back(0.5 * seg.dt[l]);
+            split = true;
+        }
+
+        std::swap(seg.dt, dt);
+        std::swap(seg.dxi, dxi);
+    }
+}
+
+void PlatenSolver::integrals(const Segment& seg, std::size_t n_noises,
+                             std::vector<Complex>& dxi, std::vector<Complex>& J) {
+    const std::size_t m = n_noises;
+    const std::size_t n = seg.dt.size();
+
+    dxi.assign(m, 0.);
+    for (std::size_t l = 0; l < n; ++l)
+        for (std::size_t k = 0; k < m; ++k) dxi[k] += seg.dxi[l * m + k];
+
+    if (!areas) {
+        J.clear();
+        return;
+    }
+
+    // Real noises: dW_2k = sqrt(2) Re dxi_k, dW_2k+1 = sqrt(2) Im dxi_k
+    const std::size_t R = 2 * m;
+    std::vector<double> W(R, 0.), dW(R);
+
+    // A[j1 R + j2] = sum_l W_j1 dW_j2 - W_j2 dW_j1 (j1 < j2), W: before piece l
+    std::vector<double> A(R * R, 0.);
+    for (std::size_t l = 0; l < n; ++l) {
+        for (std::size_t k = 0; k < m; ++k) {
+            dW[2 * k] = M_SQRT2 * seg.dxi[l * m + k].real();
+            dW[2 * k + 1] = M_SQRT2 * seg.dxi[l * m + k].imag();
+        }
+        for (std::size_t j1 = 0; j1 < R; ++j1)
+            for (std::size_t j2 = j1 + 1; j2 < R; ++j2) A[j1 * R + j2] += W[j1] * dW[j2] - W[j2] * dW[j1];
+        for (std::size_t j = 0; j < R; ++j) W[j] += dW[j];
+    }
+
+    // I_(j, j) = 1/2 (dW_j^2 - h)
+    // I_(j1, j2) = 1/2 dW_j1 dW_j2 + Levy area, the area of each piece is dropped
+    auto I = [&](std::size_t j1, std::size_t j2) -> double {
+        if (j1 == j2) return 0.5 * (W[j1] * W[j1] - seg.h);
+        double area = (j1 < j2) ? A[j1 * R + j2] : -A[j2 * R + j1];
+        return 0.5 * (W[j1] * W[j2] + area);
+    };
+
+    J.resize(R * m);
+    for (std::size_t j = 0; j < R; ++j)
+        for (std::size_t k = 0; k < m; ++k) J[j * m + k] = Complex(I(j, 2 * k), I(j, 2 * k + 1));
+}
+
+void PlatenSolver::step(SDE* sde, State& yout, const State& y, double t, double h,
+                        const std::vector<Complex>& dxi, const std::vector<Complex>& J) {
+    auto a_g = pool.allocate_similar(y);
+    State& a = a_g.state;
+
+    auto b_g = pool.allocate_similar(y);
+    State& b = b_g.state;
+
+    auto bs_g = pool.allocate_similar(y);
+    State& bs = bs_g.state;
+
+    auto sup_g = pool.allocate_similar(y);
+    State& sup = sup_g.state;
+
+    const std::size_t m = sde->n_noises();
+
+    sde->drift(a, y, t);
+
+    if (!J.empty()) {
+        // y(t + h) = y + a h + sum_k b_k dxi_k + 1/sqrt(2h) sum_{j, k} J[j m + k] (b_k(Y_j) - b_k)
+        //  Y_2k = y + a h + sqrt(h / 2) b_k, Y_2k+1 = y + a h + i sqrt(h / 2) b_k
+        double c = 1. / std::sqrt(2. * h);
+
+        yout = y;
+        yout.axpy(h, a);
+        for (std::size_t k = 0; k < m; ++k) {
+            sde->diffusion(b, y, t, k);
+
+            Complex sum_J = 0.;
+            for (std::size_t j = 0; j < 2 * m; ++j) sum_J += J[j * m + k];
+            yout.axpy(dxi[k] - c * sum_J, b);
+        }
+
+        for (std::size_t j = 0; j < 2 * m; ++j) {
+            sde->diffusion(b, y, t, j / 2);
+            sup = y;
+            sup.axpy(h, a);
+            sup.axpy(((j % 2) ? _I : Complex(1.)) * std::sqrt(0.5 * h), b);
+
+            for (std::size_t k = 0; k < m; ++k) {
+                sde->diffusion(bs, sup, t, k);
+                yout.axpy(c * J[j * m + k], bs);
+            }
+        }
+        return;
+    }
+
+    // Commutative noise
+    // y(t + h) = y + a h + g + 1/2 (g(y + g) - g(y)) - 1/2 h sum_j L^j b^j
+    //  g = sum_k b_k dxi_k
+    //  1/2 h sum_j L^j b^j = 1/4 sqrt(h) sum_k [(b_k(y + sqrt(h) b_k) - b_k) + i (b_k(y + i sqrt(h) b_k) - b_k)]
+
+    auto g_g = pool.allocate_similar(y);
+    State& g = g_g.state;
+
+    auto corr_g = pool.allocate_similar(y);
+    State& corr = corr_g.state;
+
+    double sqrt_h = std::sqrt(h);
+
+    g = 0.;
+    corr = 0.;
+    for (std::size_t k = 0; k < m; ++k) {
+        sde->diffusion(b, y, t, k);
+        g.axpy(dxi[k], b);
+
+        // Ito correction along the real part
+        sup = y;
+        sup.axpy(sqrt_h, b);
+        sde->diffusion(bs, sup, t, k);
+        corr += bs;
+        corr -= b;
+
+        // Ito correction along the imaginary part
+        sup = y;
+        sup.axpy(_I * sqrt_h, b);
+        sde->diffusion(bs, sup, t, k);
+        corr.axpy(_I, bs);
+        corr.axpy(_MI, b);
+    }
+
+    // Support value along the total noise
+    sup = y;
+    sup += g;
+
+    yout = y;
+    yout.axpy(h, a);
+    yout.axpy(0.5, g);
+    for (std::size_t k = 0; k < m; ++k) {
+        sde->diffusion(bs, sup, t, k);
+        yout.axpy(0.5 * dxi[k], bs);
+    }
+    yout.axpy(-0.25 * sqrt_h, corr);
+}
+
+void PlatenSolver::solve(SDE* sde, State& psi, double t1, double t2) {
+    Assert(t2 > t1);
+    if (h <= 0) Error("The stochastic step size is not set!");
+
+    auto psi_tmp_g = pool.allocate_similar(psi);
+    State& psi_tmp = psi_tmp_g.state;
+
+    State* y = &psi;
+    State* yout = &psi_tmp;
+
+    areas = !sde->commutative_noise();
+
+    Segment seg;
+    std::vector<Complex> dxi, J;
+    while (t1 < t2) {
+        bool last = (t2 - t1 <= h * (1 + 1e-10));
+        double dt = last ? t2 - t1 : h;
+
+        draw(seg, sde->n_noises(), dt);
+        integrals(seg, sde->n_noises(), dxi, J);
+        step(sde, *yout, *y, t1, dt, dxi, J);
+
+        t1 = last ? t2 : t1 + dt;
+        sde->on_step(*yout, t1);
+        std::swap(y, yout);
+    }
+
+    if (y != &psi) psi = *y;
+}
+
+// AdaptivePlatenSolver
+
+// Integrals over [0, h_a + h_b) from those over [0, h_a) and [h_a, h_a + h_b) (Chen)
+//  I_(j1, j2) = I_a,(j1, j2) + I_b,(j1, j2) + dW_a,j1 dW_b,j2
+static void compose(std::vector<Complex>& dxi, std::vector<Complex>& J,
+                    const std::vector<Complex>& dxi_a, const std::vector<Complex>& J_a,
+                    const std::vector<Complex>& dxi_b, const std::vector<Complex>& J_b) {
+    const std::size_t m = dxi_a.size();
+
+    dxi.resize(m);
+    for (std::size_t k = 0; k < m; ++k) dxi[k] = dxi_a[k] + dxi_b[k];
+
+    if (J_a.empty()) {
+        J.clear();
+        return;
+    }
+
+    // dW_a,j (dW_b,2k + i dW_b,2k+1) = dW_a,j sqrt(2) dxi_b,k
+    J.resize(J_a.size());
+    for (std::size_t j = 0; j < 2 * m; ++j) {
+        double dW_a = M_SQRT2 * ((j % 2) ? dxi_a[j / 2].imag() : dxi_a[j / 2].real());
+        for (std::size_t k = 0; k < m; ++k)
+            J[j * m + k] = J_a[j * m + k] + J_b[j * m + k] + M_SQRT2 * dW_a * dxi_b[k];
+    }
+}
+
+void AdaptivePlatenSolver::solve(SDE* sde, State& psi, double t1, double t2) {
+    Assert(t2 > t1);
+
+    auto y_full_g = pool.allocate_similar(psi);
+    State& y_full = y_full_g.state;
+
+    auto y_half_g = pool.allocate_similar(psi);
+    State& y_half = y_half_g.state;
+
+    auto y_out_g = pool.allocate_similar(psi);
+    State& y_out = y_out_g.state;
+
+    areas = !sde->commutative_noise();
+
+    // Future pieces of the last interval are independent of this one
+    pending.clear();
+
+    const double t_eps = 1e-12 * (t2 - t1);
+    double h_next = h_suggested;
+
+    std::vector<Complex> dxi_full, J_full, dxi_first, J_first, dxi_second, J_second;
+    for (std::size_t nstep = 0; nstep < max_nsteps; ++nstep) {
+        if (t2 - t1 <= t_eps) {
+            pending.clear();
+            return;
+        }
+
+        // Next piece of the path
+        Segment full;
+        if (pending.empty()) {
+            draw(full, sde->n_noises(), std::min(std::max(h_next, h_min), h_max));
+        } else {
+            full = std::move(pending.back());
+            pending.pop_back();
+        }
+        if (full.h > t2 - t1) bridge(full, t2 - t1); // The tail is beyond t2
+
+        // One full step and two half steps on the same path
+        Segment first = full;
+        Segment second = bridge(first, 0.5 * full.h);
+        refine(first);
+        refine(second);
+
+        integrals(first, sde->n_noises(), dxi_first, J_first);
+        integrals(second, sde->n_noises(), dxi_second, J_second);
+        compose(dxi_full, J_full, dxi_first, J_first, dxi_second, J_second);
+
+        step(sde, y_full, psi, t1, full.h, dxi_full, J_full);
+        sde->on_step(y_full, t1 + full.h);
+
+        step(sde, y_half, psi, t1, first.h, dxi_first, J_first);
+        sde->on_step(y_half, t1 + first.h);
+        step(sde, y_out, y_half, t1 + first.h, second.h, dxi_second, J_second);
+        sde->on_step(y_out, t1 + full.h);
+
+        y_full -= y_out;
+        double err = y_full.norm();
+
+        if (err <= atol || full.h <= h_min) {
+            // Accept
+            psi = y_out;
+            t1 += full.h;
+
+            double grow = (err > 0) ? SAFETY * std::pow(err / atol, PGROW) : MAX_GROW;
+            h_next = full.h * std::min(grow, MAX_GROW);
+
+        } else {
+            // Reject, retry on the first half and keep the second half of the path
+            pending.push_back(std::move(second));
+            pending.push_back(std::move(first));
+        }
+    }
+
+    Error("Max. sde steps exceeded.");
+}
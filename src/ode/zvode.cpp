@@ -62,6 +62,7 @@ double ZVODESolver::solve_one_step(ODE* ode, State& psi1, double t1, double t2)
            zwork.data(), &lzw, rwork.data(), &lrw, iwork.data(), &liw,
            nullptr, &mf, ode, &psi1
           );
+    if (psi1.tracks_blocks()) psi1.refresh_blocks(); // Written by zvode: blocks it left all zero are empty
 
     if (istate < 0) on_error(istate);
 
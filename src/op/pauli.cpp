@@ -0,0 +1,58 @@
+#include "op/pauli.h"
+
+#include <bitset>
+
+#include "base/assertion.h"
+
+PauliString::PauliString(const std::string& paulis) : n(paulis.size()) {
+    for (sz_t q = 0; q < n; ++q) {
+        sz_t bit = sz_t(1) << (n - 1 - q);
+        switch (paulis[q]) {
+            case 'I': break;
+            case 'X': flip |= bit; break;
+            case 'Y': flip |= bit; sign |= bit; phase *= _I; break;
+            case 'Z': sign |= bit; break;
+            default: Error("Unknown Pauli: " << paulis[q]);
+        }
+    }
+}
+
+static bool odd(sz_t x) {
+    return std::bitset<64>(x).count() & 1;
+}
+
+void PauliString::apply(State& out, const State& s, double t) {
+    Assert(s.total_dims() == (sz_t(1) << n) && out.data() != s.data());
+
+    for (sz_t i = 0; i < s.total_dims(); ++i) {
+        Complex x = phase * s[i];
+        out[i ^ flip] = odd(i & sign) ? -x : x;
+    }
+    out.mark_all_blocks();
+}
+
+double PauliString::expectation(const State& s) const {
+    std::vector<double> res;
+    expectations(res, s, {this});
+    return res[0];
+}
+
+void PauliString::expectations(std::vector<double>& res, const State& s, const std::vector<const PauliString*>& ps) {
+    for (auto p : ps) Assert(s.total_dims() == (sz_t(1) << p->n));
+
+    std::vector<Complex> acc(ps.size(), 0.);
+    double norm2 = 0.;
+    for (sz_t i = 0; i < s.total_dims(); ++i) {
+        Complex x = s[i];
+        if (x == 0.) continue;
+        norm2 += std::norm(x);
+
+        for (std::size_t k = 0; k < ps.size(); ++k) {
+            Complex y = std::conj(s[i ^ ps[k]->flip]) * x;
+            acc[k] += odd(i & ps[k]->sign) ? -y : y;
+        }
+    }
+
+    res.resize(ps.size());
+    for (std::size_t k = 0; k < ps.size(); ++k) res[k] = (ps[k]->phase * acc[k]).real() / norm2;
+}
@@ -1,5 +1,7 @@
 #include "op/prim2_op.h"
 
+#include <vector>
+
 void Prim2Op::apply(State& out, const State& s, double t) {
     out = s;
     inplace_apply(out, t);
@@ -20,12 +22,82 @@ void Prim2Op::inplace_apply(State& s, double t) {
     sz_t min_skip = s.skip(max_freedom);
     sz_t next_min_skip = s.skip(max_freedom - 1);
 
-    for (sz_t i = 0; i < s.total_dims(); i += next_max_skip) {
-        for (sz_t j = 0; j < max_skip; j += next_min_skip) {
-            for (sz_t k = 0; k < min_skip; ++k) {
-                v.data = s.data() + i + j + k;
-                apply_inplace(v, t);
+    auto sweep = [&](sz_t begin, sz_t end) {
+        for (sz_t i = begin; i < end; i += next_max_skip) {
+            for (sz_t j = 0; j < max_skip; j += next_min_skip) {
+                for (sz_t k = 0; k < min_skip; ++k) {
+                    v.data = s.data() + i + j + k;
+                    apply_inplace(v, t);
+                }
+            }
+        }
+    };
+
+    sz_t B = s.block_size();
+
+    // The blocks of a group of amplitudes (offsets: multiples of B), empty groups stay empty
+    auto group_occupied = [&](sz_t base, const std::vector<sz_t>& offsets) {
+        bool occupied = false;
+        for (auto o : offsets) occupied = occupied || s.block_occupied((base + o) / B);
+        return occupied;
+    };
+    auto mark_group = [&](sz_t base, const std::vector<sz_t>& offsets) {
+        if (is_diagonal()) return;
+        for (auto o : offsets) s.set_block_occupied((base + o) / B, true);
+    };
+
+    sz_t d_min = s.dim(min_freedom), d_max = s.dim(max_freedom);
+    if (!s.tracks_blocks()) {
+        sweep(0, s.total_dims());
+
+    } else if (B % next_max_skip == 0) {
+        // Inside blocks: empty blocks stay empty
+        for (sz_t b = 0; b < s.n_blocks(); ++b) {
+            if (s.block_occupied(b)) sweep(b * B, (b + 1) * B);
+        }
+
+    } else if (min_skip % B == 0) {
+        // Both across blocks: a group of d_min x d_max blocks
+        std::vector<sz_t> offsets;
+        for (sz_t a = 0; a < d_min; ++a) {
+            for (sz_t c = 0; c < d_max; ++c) offsets.push_back(a * max_skip + c * min_skip);
+        }
+
+        for (sz_t i = 0; i < s.total_dims(); i += next_max_skip) {
+            for (sz_t j = 0; j < max_skip; j += next_min_skip) {
+                for (sz_t k = 0; k < min_skip; k += B) {
+                    if (!group_occupied(i + j + k, offsets)) continue;
+
+                    for (sz_t kk = k; kk < k + B; ++kk) {
+                        v.data = s.data() + i + j + kk;
+                        apply_inplace(v, t);
+                    }
+                    mark_group(i + j + k, offsets);
+                }
             }
         }
+
+    } else if (max_skip % B == 0 && B % next_min_skip == 0) {
+        // min_freedom across blocks, max_freedom inside: a group of d_min blocks
+        std::vector<sz_t> offsets;
+        for (sz_t a = 0; a < d_min; ++a) offsets.push_back(a * max_skip);
+
+        for (sz_t i = 0; i < s.total_dims(); i += next_max_skip) {
+            for (sz_t j = 0; j < max_skip; j += B) {
+                if (!group_occupied(i + j, offsets)) continue;
+
+                for (sz_t jj = j; jj < j + B; jj += next_min_skip) {
+                    for (sz_t k = 0; k < min_skip; ++k) {
+                        v.data = s.data() + i + jj + k;
+                        apply_inplace(v, t);
+                    }
+                }
+                mark_group(i + j, offsets);
+            }
+        }
+
+    } else {
+        sweep(0, s.total_dims());
+        if (!is_diagonal()) s.refresh_blocks();
     }
 }
\ No newline at end of file
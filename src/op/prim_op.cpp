@@ -15,10 +15,46 @@ void PrimOp::inplace_apply(State& s, double t) {
 
     sz_t next_skip = s.skip(the_freedom - 1);
 
-    for (sz_t j = 0; j < s.total_dims(); j += next_skip) {
-        for (sz_t i = 0; i < skip; ++i) {
-            v.data = s.data() + i + j;
-            apply_inplace(v, t);
+    auto sweep = [&](sz_t begin, sz_t end) {
+        for (sz_t j = begin; j < end; j += next_skip) {
+            for (sz_t i = 0; i < skip; ++i) {
+                v.data = s.data() + i + j;
+                apply_inplace(v, t);
+            }
         }
+    };
+
+    sz_t B = s.block_size();
+    if (!s.tracks_blocks()) {
+        sweep(0, s.total_dims());
+
+    } else if (B % next_skip == 0) {
+        // Inside blocks: empty blocks stay empty
+        for (sz_t b = 0; b < s.n_blocks(); ++b) {
+            if (s.block_occupied(b)) sweep(b * B, (b + 1) * B);
+        }
+
+    } else if (skip % B == 0) {
+        // Across blocks: a group of dim(the_freedom) blocks, empty groups stay empty
+        sz_t d = s.dim(the_freedom);
+        for (sz_t j = 0; j < s.total_dims(); j += next_skip) {
+            for (sz_t i = 0; i < skip; i += B) {
+                bool occupied = false;
+                for (sz_t k = 0; k < d; ++k) occupied = occupied || s.block_occupied((j + i + k * skip) / B);
+                if (!occupied) continue;
+
+                for (sz_t ii = i; ii < i + B; ++ii) {
+                    v.data = s.data() + ii + j;
+                    apply_inplace(v, t);
+                }
+                if (!is_diagonal()) {
+                    for (sz_t k = 0; k < d; ++k) s.set_block_occupied((j + i + k * skip) / B, true);
+                }
+            }
+        }
+
+    } else {
+        sweep(0, s.total_dims());
+        if (!is_diagonal()) s.refresh_blocks();
     }
-}
\ No newline at end of file
+}
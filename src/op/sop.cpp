@@ -1,6 +1,7 @@
 #include "op/sop.h"
 
 #include <iostream>
+#include <algorithm>
 #include "base/assertion.h"
 
 #ifdef CHECK_MKL_SPARSE_CALL
@@ -160,7 +161,19 @@ SOp SOp::id_like(const SOp& op) {
     return id_like(op.mat.rows());
 }
 
+SOp SOp::view(const CSR& csr, SOpProperty prop) {
+    Assert(csr.values && csr.columns && csr.rows);
+    Assert(csr.rows[csr.n_rows] == (MKL_INT)csr.nnz);
+
+    SOp op;
+    op.prop = std::move(prop);
+    op.is_csr_view = true;
+    op.view_csr = csr;
+    return op;
+}
+
 SOp& SOp::operator+=(const SOp& op) {
+    Assert_msg(!is_csr_view && !op.is_csr_view, "Views are read-only");
     is_mkl_inited = false;
     mat += op.mat;
     prop += op.prop;
@@ -169,6 +182,7 @@ SOp& SOp::operator+=(const SOp& op) {
 }
 
 SOp& SOp::operator-=(const SOp& op) {
+    Assert_msg(!is_csr_view && !op.is_csr_view, "Views are read-only");
     is_mkl_inited = false;
     mat -= op.mat;
     prop -= op.prop;
@@ -177,6 +191,7 @@ SOp& SOp::operator-=(const SOp& op) {
 }
 
 SOp& SOp::operator*=(const SOp& op) {
+    Assert_msg(!is_csr_view && !op.is_csr_view, "Views are read-only");
     is_mkl_inited = false;
     mat *= op.mat;
     prop *= op.prop;
@@ -185,6 +200,7 @@ SOp& SOp::operator*=(const SOp& op) {
 }
 
 SOp& SOp::operator*=(Complex a) {
+    Assert_msg(!is_csr_view, "Views are read-only");
     is_mkl_inited = false;
     mat *= a;
     prop *= a;
@@ -193,6 +209,7 @@ SOp& SOp::operator*=(Complex a) {
 }
 
 SOp& SOp::tensor(const SOp& op) {
+    Assert_msg(!is_csr_view && !op.is_csr_view, "Views are read-only");
     is_mkl_inited = false;
     mat = blaze::kron(mat, op.mat);
     prop.tensor(op.prop);
@@ -207,15 +224,26 @@ void SOp::apply(State& out, const State& s, double t) {
     BEFORE_ANY_MKL_SPARSE_CALL
 
     if (prop.diagonal) {
-        std::size_t size = values.size();
-        const Complex* va = values.data();
+        const Complex* va = csr_values();
         const Complex* vb = s.data();
         Complex* vr = out.data();
 
-        for (std::size_t i = 0; i < size; ++i) vr[i] = va[i] * vb[i];
+        // Empty blocks of s give empty blocks of out
+        std::size_t B = s.block_size();
+        bool out_same = out.tracks_blocks() && out.block_size() == B;
+        for (std::size_t b = 0; b < s.n_blocks(); ++b) {
+            if (s.block_occupied(b)) {
+                for (std::size_t i = b * B; i < (b + 1) * B; ++i) vr[i] = va[i] * vb[i];
+            } else if (!out_same || out.block_occupied(b)) {
+                std::fill(vr + b * B, vr + (b + 1) * B, Complex{0.});
+            }
+        }
+        if (s.tracks_blocks()) out.copy_blocks(s);
+        else out.mark_all_blocks();
 
     } else {
         CALL_MKL_SPARSE(mkl_sparse_z_mv(SPARSE_OPERATION_NON_TRANSPOSE, Complex{1.0}, mat_mkl, descr_mkl, s.data(), Complex{0.0}, out.data()));
+        out.mark_all_blocks();
     }
 }
 
@@ -225,15 +253,20 @@ void SOp::axpy_apply(State& out, Complex a, const State& x, double t) {
     BEFORE_ANY_MKL_SPARSE_CALL
 
     if (prop.diagonal) {
-        std::size_t size = values.size();
-        const Complex* va = values.data();
+        const Complex* va = csr_values();
         const Complex* vb = x.data();
         Complex* vr = out.data();
 
-        for (std::size_t i = 0; i < size; ++i) vr[i] += a * va[i] * vb[i];
+        std::size_t B = x.block_size();
+        for (std::size_t b = 0; b < x.n_blocks(); ++b) {
+            if (!x.block_occupied(b)) continue;
+            for (std::size_t i = b * B; i < (b + 1) * B; ++i) vr[i] += a * va[i] * vb[i];
+        }
+        out.merge_blocks(x);
 
     } else {
         CALL_MKL_SPARSE(mkl_sparse_z_mv(SPARSE_OPERATION_NON_TRANSPOSE, a, mat_mkl, descr_mkl, x.data(), Complex{1.0}, out.data()));
+        out.mark_all_blocks();
     }
 }
 
@@ -243,21 +276,46 @@ void SOp::axpby_apply(State& out, Complex a, const State& x, Complex b, double t
     BEFORE_ANY_MKL_SPARSE_CALL
 
     if (prop.diagonal) {
-        std::size_t size = values.size();
-        const Complex* va = values.data();
+        std::size_t size = nnz();
+        const Complex* va = csr_values();
         const Complex* vb = x.data();
         Complex* vr = out.data();
 
         for (std::size_t i = 0; i < size; ++i) vr[i] = b * vr[i] + a * va[i] * vb[i];
+        out.merge_blocks(x);
 
     } else {
         CALL_MKL_SPARSE(mkl_sparse_z_mv(SPARSE_OPERATION_NON_TRANSPOSE, a, mat_mkl, descr_mkl, x.data(), b, out.data()));
+        out.mark_all_blocks();
     }
 }
 
+SOp::CSR SOp::csr() {
+    init_mkl();
+    if (is_csr_view) return view_csr;
+    return CSR{mat.rows(), mat.columns(), values.size(), values.data(), columns.data(), rows.data()};
+}
+
 void SOp::init_mkl() {
     if (is_mkl_inited) return;
 
+    if (is_csr_view) {
+        BEFORE_ANY_MKL_SPARSE_CALL
+
+        if (mat_mkl) {
+            CALL_MKL_SPARSE(mkl_sparse_destroy(mat_mkl));
+        }
+
+        // MKL only reads the arrays, no mkl_sparse_optimize: it would keep a private copy of them
+        auto& v = view_csr;
+        CALL_MKL_SPARSE(mkl_sparse_z_create_csr(&mat_mkl, SPARSE_INDEX_BASE_ZERO, v.n_rows, v.n_cols,
+            const_cast<MKL_INT*>(v.rows), const_cast<MKL_INT*>(v.rows) + 1, const_cast<MKL_INT*>(v.columns), const_cast<Complex*>(v.values)));
+        descr_mkl.type = SPARSE_MATRIX_TYPE_GENERAL;
+
+        is_mkl_inited = true;
+        return;
+    }
+
     auto nnz = mat.nonZeros();
 
     // CSR mat
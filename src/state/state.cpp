@@ -1,6 +1,12 @@
 #include "state/state.h"
 #include "base/assertion.h"
 #include "base/blas.h"
+#include "stats/stats.h"
+
+#include <algorithm>
+#include <cmath>
+
+template<typename T> T pow2(T x) { return x * x; }
 
 State::State(std::vector<sz_t> dims, sz_t basis) : dims(std::move(dims)) {
     init_skips();
@@ -31,35 +37,107 @@ State::State(const std::vector<const State*>& states) {
     }
 }
 
+// f(begin, n) on every run of occupied blocks
+template<typename F>
+static void for_occupied(const State& s, F f) {
+    if (!s.tracks_blocks()) {
+        f(0, s.total_dims());
+        return;
+    }
+
+    sz_t B = s.block_size(), nb = s.n_blocks();
+    for (sz_t b = 0; b < nb;) {
+        if (!s.block_occupied(b)) { ++b; continue; }
+
+        sz_t e = b + 1;
+        while (e < nb && s.block_occupied(e)) ++e;
+        f(b * B, (e - b) * B);
+        b = e;
+    }
+}
+
+static bool same_blocks(const State& a, const State& b) {
+    return a.tracks_blocks() && b.tracks_blocks() && a.block_size() == b.block_size();
+}
+
 State& State::operator*=(Complex a) {
-    cblas_zscal(total_dims(), &a, data(), 1);
+    if (a == 0.) return *this = Complex{0.};
+
+    for_occupied(*this, [&](sz_t i, sz_t n) { cblas_zscal(n, &a, data() + i, 1); });
     return *this;
 }
 
 State& State::mul(Complex a, const State& x) {
     Complex zero{0.0, 0.0};
-    cblas_zaxpby(total_dims(), &a, x.data(), 1, &zero, data(), 1);
+
+    if (x.tracks_blocks()) {
+        sz_t B = x.block_size();
+        for (sz_t b = 0; b < x.n_blocks(); ++b) {
+            if (x.block_occupied(b)) {
+                cblas_zaxpby(B, &a, x.data() + b * B, 1, &zero, data() + b * B, 1);
+            } else if (!same_blocks(*this, x) || block_occupied(b)) {
+                std::fill(data() + b * B, data() + (b + 1) * B, zero);
+            }
+        }
+        copy_blocks(x);
+    } else {
+        cblas_zaxpby(total_dims(), &a, x.data(), 1, &zero, data(), 1);
+        mark_all_blocks();
+    }
     return *this;
 }
 
 State& State::axpy(Complex a, const State& x) {
-    cblas_zaxpy(total_dims(), &a, x.data(), 1, data(), 1);
+    for_occupied(x, [&](sz_t i, sz_t n) { cblas_zaxpy(n, &a, x.data() + i, 1, data() + i, 1); });
+    merge_blocks(x);
     return *this;
 }
 
 State& State::axpby(Complex a, const State& x, Complex b) {
-    cblas_zaxpby(total_dims(), &a, x.data(), 1, &b, data(), 1);
+    if (same_blocks(*this, x)) {
+        sz_t B = blk_size;
+        for (sz_t k = 0; k < n_blocks(); ++k) {
+            if (x.block_occupied(k)) {
+                cblas_zaxpby(B, &a, x.data() + k * B, 1, &b, data() + k * B, 1);
+            } else if (block_occupied(k)) {
+                cblas_zscal(B, &b, data() + k * B, 1);
+            }
+        }
+    } else {
+        cblas_zaxpby(total_dims(), &a, x.data(), 1, &b, data(), 1);
+    }
+    merge_blocks(x);
     return *this;
 }
 
 Complex State::inner(const State& s) const {
-    Complex res;
-    cblas_zdotc_sub(total_dims(), data(), 1, s.data(), 1, &res);
+    Complex res = 0;
+
+    if (same_blocks(*this, s)) {
+        sz_t B = blk_size;
+        for (sz_t k = 0; k < n_blocks(); ++k) {
+            if (!block_occupied(k) || !s.block_occupied(k)) continue;
+            Complex r;
+            cblas_zdotc_sub(B, data() + k * B, 1, s.data() + k * B, 1, &r);
+            res += r;
+        }
+    } else {
+        const State& sparser = tracks_blocks() ? *this : s;
+        for_occupied(sparser, [&](sz_t i, sz_t n) {
+            Complex r;
+            cblas_zdotc_sub(n, data() + i, 1, s.data() + i, 1, &r);
+            res += r;
+        });
+    }
     return res;
 }
 
 double State::norm() const {
-    return cblas_dznrm2(total_dims(), data(), 1);
+    if (!tracks_blocks()) return cblas_dznrm2(total_dims(), data(), 1);
+
+    double norm2 = 0;
+    for_occupied(*this, [&](sz_t i, sz_t n) { norm2 += pow2(cblas_dznrm2(n, data() + i, 1)); });
+    return std::sqrt(norm2);
 }
 
 void State::normalize() {
@@ -69,84 +147,160 @@ void State::normalize() {
     }
 }
 
-static std::uniform_real_distribution<double> measure_rnd{0.0, 1.0};
-template<typename T> T pow2(T x) { return x * x; }
+void State::track_blocks(sz_t block_size) {
+    blk_size = std::min(block_size, total_dims());
+    Assert(blk_size > 0 && total_dims() % blk_size == 0);
 
-class BigNum {
-public:
-    std::vector<sz_t> ns;
-    const std::vector<sz_t>& dims;
+    blk_occupied.assign(total_dims() / blk_size, 1);
+    refresh_blocks();
+}
 
-    BigNum(const std::vector<sz_t>& dims, std::size_t num) : ns(dims.size(), 0), dims(dims) {
-        reset(num);
+void State::refresh_blocks() {
+    for (sz_t b = 0; b < blk_occupied.size(); ++b) {
+        const Complex* p = data() + b * blk_size;
+        blk_occupied[b] = std::any_of(p, p + blk_size, [](const Complex& x) { return x != 0.; });
     }
+}
 
-    void reset(std::size_t num) {
-        for (std::size_t i = dims.size(); i-- > 0;) {
-            ns[i] = num % dims[i];
-            num /= dims[i];
-        }
-    }
+void State::merge_blocks(const State& s) {
+    if (!tracks_blocks()) return;
 
-    void add_one() {
-        for (std::size_t i = dims.size(); i-- > 0;) {
-            if (ns[i] < dims[i] - 1) {
-                ++ns[i];
-                break;
-            } else ns[i] = 0;
-        }
+    if (same_blocks(*this, s)) {
+        for (sz_t b = 0; b < blk_occupied.size(); ++b) blk_occupied[b] |= s.blk_occupied[b];
+    } else {
+        mark_all_blocks();
     }
+}
 
-    sz_t operator[](std::size_t i) const {
-        return ns[i];
-    }
-};
+double State::occupied_fraction() const {
+    if (!tracks_blocks()) return 1.;
+    return (double)std::count(blk_occupied.begin(), blk_occupied.end(), 1) / blk_occupied.size();
+}
 
-std::vector<sz_t> State::measure(const std::vector<sz_t>& frees, std::mt19937& eng) {
-    // Random a prob
-    double norm2 = pow2(this->norm());
-    double r = measure_rnd(eng) * norm2;
+static std::uniform_real_distribution<double> measure_rnd{0.0, 1.0};
+
+// First basis state where the cumulative probability exceeds r (empty blocks skipped)
+sz_t State::sample_basis(double r) const {
+    sz_t B = block_size();
 
-    // Measure the whole state
     sz_t meas = 0;
     for (double sum = 0; meas < total_dims(); ++meas) {
+        if (meas % B == 0 && !block_occupied(meas / B)) {
+            meas += B - 1;
+            continue;
+        }
+
         sum += std::norm(data()[meas]);
         if (sum > r) break;
     }
-    BigNum meas_big{dims, meas};
+    return meas;
+}
+
+template<typename F>
+void State::for_runs(const std::vector<sz_t>& frees, F f) const {
+    Assert(!frees.empty());
+
+    sz_t run = total_dims();
+    for (auto idx : frees) {
+        Assert(idx < n_freedoms());
+        run = std::min(run, skip(idx));
+    }
 
-    // Only care about frees
-    auto match = [&meas_big, &frees](const BigNum& num) -> bool {
-        for (auto idx : frees) {
-            if (num[idx] != meas_big[idx]) return false;
+    sz_t B = block_size();
+    bool skip_empty = tracks_blocks() && B % run == 0;
+    for (sz_t i = 0; i < total_dims(); i += run) {
+        if (skip_empty && !block_occupied(i / B)) continue;
+
+        sz_t outcome = 0;
+        for (auto idx : frees) outcome = outcome * dims[idx] + (i / skip(idx)) % dims[idx];
+        f(i, run, outcome);
+    }
+}
+
+static sz_t n_outcomes(const State& s, const std::vector<sz_t>& frees) {
+    sz_t n = 1;
+    for (auto idx : frees) n *= s.dim(idx);
+    return n;
+}
+
+std::vector<double> State::marginal(const std::vector<sz_t>& frees) const {
+    std::vector<double> p(n_outcomes(*this, frees), 0.);
+
+    double norm2 = 0;
+    for_runs(frees, [&](sz_t begin, sz_t run, sz_t outcome) {
+        double sum = 0;
+        const Complex* x = data() + begin;
+        for (sz_t j = 0; j < run; ++j) sum += std::norm(x[j]);
+        p[outcome] += sum;
+        norm2 += sum;
+    });
+
+    Assert(norm2 > 0);
+    for (auto& x : p) x /= norm2;
+    return p;
+}
+
+std::vector<sz_t> State::sample(const std::vector<sz_t>& frees, std::size_t n_shots, RandomEngine& eng) const {
+    AliasTable table{marginal(frees)};
+
+    std::vector<sz_t> shots;
+    shots.reserve(n_shots);
+    for (auto k : table.sample(eng, n_shots)) shots.push_back(k);
+    return shots;
+}
+
+void State::collapse(const std::vector<sz_t>& frees, sz_t outcome) {
+    double norm2 = 0;
+    for_runs(frees, [&](sz_t begin, sz_t run, sz_t o) {
+        Complex* x = data() + begin;
+        if (o == outcome) {
+            for (sz_t j = 0; j < run; ++j) norm2 += std::norm(x[j]);
+        } else {
+            std::fill(x, x + run, Complex{0.});
         }
-        return true;
-    };
+    });
 
-    // Collapse
-    BigNum i_big{dims, 0};
-    for (sz_t i = 0; i < total_dims(); ++i, i_big.add_one()) {
-        if (!match(i_big)) data()[i] = 0.;
+    if (tracks_blocks()) refresh_blocks();
+
+    Assert(norm2 > 0);
+    *this *= 1. / std::sqrt(norm2);
+}
+
+std::vector<sz_t> State::outcome_values(const std::vector<sz_t>& frees, sz_t outcome) const {
+    std::vector<sz_t> values(frees.size());
+    for (std::size_t j = frees.size(); j-- > 0;) {
+        values[j] = outcome % dims[frees[j]];
+        outcome /= dims[frees[j]];
     }
-    normalize();
-    
+    return values;
+}
+
+std::vector<sz_t> State::measure(const std::vector<sz_t>& frees, RandomEngine& eng) {
+    // Random an outcome from the marginal
+    std::vector<double> p = marginal(frees);
+    double r = measure_rnd(eng);
+
+    sz_t outcome = 0;
+    for (double sum = 0; outcome < p.size() - 1; ++outcome) {
+        sum += p[outcome];
+        if (sum > r && p[outcome] > 0) break;
+    }
+    while (p[outcome] == 0 && outcome > 0) --outcome; // Rounding at the end
+
+    // Collapse
+    collapse(frees, outcome);
+
     // Return measure result
-    std::vector<sz_t> ret;
-    for (auto idx : frees) ret.push_back(meas_big[idx]);
-    return ret;
-};
+    return outcome_values(frees, outcome);
+}
 
-sz_t State::measure2(sz_t qubits, std::mt19937& eng) {
+sz_t State::measure2(sz_t qubits, RandomEngine& eng) {
     // Random a prob
     double norm2 = pow2(this->norm());
     double r = measure_rnd(eng) * norm2;
 
     // Measure the whole state
-    sz_t meas = 0;
-    for (double sum = 0; meas < total_dims(); ++meas) {
-        sum += std::norm(data()[meas]);
-        if (sum > r) break;
-    }
+    sz_t meas = sample_basis(r);
 
     // Only care about frees
     meas &= qubits;
@@ -155,8 +309,16 @@ sz_t State::measure2(sz_t qubits, std::mt19937& eng) {
     };
 
     // Collapse
-    for (sz_t i = 0; i < total_dims(); ++i) {
-        if (!match(i)) data()[i] = 0.;
+    sz_t B = block_size();
+    for (sz_t b = 0; b < n_blocks(); ++b) {
+        if (!block_occupied(b)) continue;
+
+        bool occupied = false;
+        for (sz_t i = b * B; i < (b + 1) * B; ++i) {
+            if (!match(i)) data()[i] = 0.;
+            else occupied = occupied || data()[i] != 0.;
+        }
+        set_block_occupied(b, occupied);
     }
     normalize();
     
@@ -164,6 +326,93 @@ sz_t State::measure2(sz_t qubits, std::mt19937& eng) {
     return meas;
 }
 
+// Bits of mask, lowest first
+static std::vector<sz_t> mask_bits(sz_t mask) {
+    std::vector<sz_t> bits;
+    for (sz_t b = 0; mask >> b; ++b) {
+        if ((mask >> b) & 1) bits.push_back(b);
+    }
+    return bits;
+}
+
+sz_t State::sample2(sz_t qubits, RandomEngine& eng, double* weight) const {
+    std::vector<sz_t> bits = mask_bits(qubits);
+    Assert(bits.size() <= 20);
+
+    // Marginal of qubits, indexed by the compressed outcome
+    std::vector<double> marginal(sz_t(1) << bits.size(), 0.);
+    double norm2 = 0;
+    sz_t B = block_size();
+    for (sz_t b = 0; b < n_blocks(); ++b) {
+        if (!block_occupied(b)) continue;
+
+        for (sz_t i = b * B; i < (b + 1) * B; ++i) {
+            double p = std::norm(data()[i]);
+            if (p == 0) continue;
+
+            sz_t k = 0;
+            for (sz_t j = 0; j < bits.size(); ++j) k |= ((i >> bits[j]) & 1) << j;
+            marginal[k] += p;
+            norm2 += p;
+        }
+    }
+
+    // Sample
+    double r = measure_rnd(eng) * norm2;
+    sz_t k = 0;
+    for (double sum = 0; k < marginal.size() - 1; ++k) {
+        sum += marginal[k];
+        if (sum > r && marginal[k] > 0) break;
+    }
+    while (marginal[k] == 0 && k > 0) --k; // Rounding at the end
+
+    if (weight) *weight = marginal[k];
+
+    sz_t outcome = 0;
+    for (sz_t j = 0; j < bits.size(); ++j) outcome |= ((k >> j) & 1) << bits[j];
+    return outcome;
+}
+
+void State::collapse2(sz_t qubits, sz_t outcome, sz_t flips, double weight) {
+    Assert((outcome & ~qubits) == 0 && (flips & ~qubits) == 0);
+
+    sz_t B = block_size();
+    if (weight <= 0) {
+        for (sz_t b = 0; b < n_blocks(); ++b) {
+            if (!block_occupied(b)) continue;
+            for (sz_t i = b * B; i < (b + 1) * B; ++i) {
+                if ((i & qubits) == outcome) weight += std::norm(data()[i]);
+            }
+        }
+    }
+    Assert(weight > 0);
+    double scale = 1. / std::sqrt(weight);
+
+    // i (outcome) -> i ^ flips, which is not an outcome when flips != 0
+    // A target is written by its source if the source block is visited, zeroed here otherwise
+    // Empty blocks are all zero and only hold skipped sources (zero) or targets of zero
+    sz_t target = outcome ^ flips;
+    std::vector<std::uint8_t> occupied(tracks_blocks() ? n_blocks() : 0, 0);
+    for (sz_t b = 0; b < n_blocks(); ++b) {
+        if (!block_occupied(b)) continue;
+
+        for (sz_t i = b * B; i < (b + 1) * B; ++i) {
+            sz_t m = i & qubits;
+            if (m == outcome) {
+                Complex a = data()[i] * scale;
+                if (flips) data()[i] = 0.;
+                data()[i ^ flips] = a;
+                if (!occupied.empty() && a != 0.) occupied[(i ^ flips) / B] = 1;
+            } else if (m != target) {
+                data()[i] = 0.;
+            } else if (!block_occupied((i ^ flips) / B)) {
+                data()[i] = 0.; // Its source is skipped
+            }
+        }
+    }
+    if (tracks_blocks()) blk_occupied = std::move(occupied);
+}
+
 void State::init_skips() {
     skips.resize(dims.size() + 1);
 
@@ -0,0 +1,225 @@
+#include "stats/stats.h"
+
+#include <random>
+#include <algorithm>
+#include <sstream>
+
+#include "base/assertion.h"
+
+double normal_quantile_two_sided(double level) {
+    Assert(level > 0 && level < 1);
+
+    // P(|Z| <= z) = erf(z / sqrt(2)), bisection
+    double lo = 0., hi = 40.;
+    for (int i = 0; i < 100; ++i) {
+        double z = 0.5 * (lo + hi);
+        if (std::erf(z * M_SQRT1_2) < level) lo = z;
+        else hi = z;
+    }
+    return 0.5 * (lo + hi);
+}
+
+// Welford
+
+void Welford::merge(const Welford& o) {
+    if (o.n == 0) return;
+    if (n == 0) { *this = o; return; }
+
+    std::size_t n_new = n + o.n;
+    double d = o.m - m;
+    m += d * o.n / n_new;
+    m2 += o.m2 + d * d * n / n_new * o.n;
+    n = n_new;
+}
+
+std::ostream& operator<<(std::ostream& out, const Welford& w) {
+    auto precision = out.precision(std::numeric_limits<double>::max_digits10);
+    out << w.n << ' ' << w.m << ' ' << w.m2;
+    out.precision(precision);
+    return out;
+}
+
+std::istream& operator>>(std::istream& in, Welford& w) {
+    return in >> w.n >> w.m >> w.m2;
+}
+
+// Intervals
+
+Interval wilson_interval(std::size_t successes, std::size_t trials, double level) {
+    Assert(successes <= trials);
+    if (trials == 0) return {0., 1.};
+
+    double z = normal_quantile_two_sided(level);
+    double z2 = z * z;
+    double n = trials;
+    double p = successes / n;
+
+    double center = (p + z2 / (2 * n)) / (1 + z2 / n);
+    double hw = z / (1 + z2 / n) * std::sqrt(p * (1 - p) / n + z2 / (4 * n * n));
+    return {std::max(0., center - hw), std::min(1., center + hw)};
+}
+
+Interval bootstrap_interval(const std::vector<double>& samples, RandomEngine& eng, double level, std::size_t n_resamples) {
+    Assert(level > 0 && level < 1);
+    if (samples.empty()) return {-std::numeric_limits<double>::infinity(), std::numeric_limits<double>::infinity()};
+
+    std::uniform_int_distribution<std::size_t> pick{0, samples.size() - 1};
+
+    std::vector<double> means(n_resamples);
+    for (auto& mean : means) {
+        double sum = 0.;
+        for (std::size_t i = 0; i < samples.size(); ++i) sum += samples[pick(eng)];
+        mean = sum / samples.size();
+    }
+    std::sort(means.begin(), means.end());
+
+    double alpha = 0.5 * (1 - level);
+    auto at = [&means](double q) {
+        std::size_t i = static_cast<std::size_t>(q * (means.size() - 1) + 0.5);
+        return means[std::min(i, means.size() - 1)];
+    };
+    return {at(alpha), at(1 - alpha)};
+}
+
+Interval ratio_interval(const std::vector<double>& num, const std::vector<double>& den, double level) {
+    Assert(num.size() == den.size());
+    std::size_t n = num.size();
+    if (n < 2) return {-std::numeric_limits<double>::infinity(), std::numeric_limits<double>::infinity()};
+
+    double sum_num = 0., sum_den = 0.;
+    for (std::size_t i = 0; i < n; ++i) {
+        sum_num += num[i];
+        sum_den += den[i];
+    }
+    Assert(sum_den > 0);
+    double r = sum_num / sum_den;
+
+    // Var(r) ~ Var(num - r den) / (n mean(den)^2)
+    Welford res;
+    for (std::size_t i = 0; i < n; ++i) res.add(num[i] - r * den[i]);
+    double mean_den = sum_den / n;
+    double hw = normal_quantile_two_sided(level) * res.sem() / mean_den;
+    return {r - hw, r + hw};
+}
+
+// AliasTable
+
+AliasTable::AliasTable(const std::vector<double>& weights) : prob(weights.size()), alias(weights.size()) {
+    Assert(!weights.empty());
+
+    double sum = 0.;
+    for (double w : weights) {
+        Assert(w >= 0);
+        sum += w;
+    }
+    Assert(sum > 0);
+
+    // Scaled to mean 1, then pair small columns with large ones
+    std::size_t n = weights.size();
+    std::vector<std::size_t> small, large;
+    for (std::size_t k = 0; k < n; ++k) {
+        prob[k] = weights[k] * n / sum;
+        alias[k] = k;
+        (prob[k] < 1. ? small : large).push_back(k);
+    }
+
+    while (!small.empty() && !large.empty()) {
+        std::size_t s = small.back(); small.pop_back();
+        std::size_t l = large.back();
+
+        alias[s] = l;
+        prob[l] -= 1. - prob[s];
+        if (prob[l] < 1.) {
+            large.pop_back();
+            small.push_back(l);
+        }
+    }
+
+    // Rounding leftovers are full columns (but never an impossible one)
+    std::size_t k_max = std::max_element(weights.begin(), weights.end()) - weights.begin();
+    for (auto k : small) {
+        prob[k] = (weights[k] > 0) ? 1. : 0.;
+        if (weights[k] == 0) alias[k] = k_max;
+    }
+    for (auto k : large) prob[k] = 1.;
+}
+
+std::size_t AliasTable::sample(RandomEngine& eng) const {
+    double u;
+    eng.fill_uniform(&u, 1);
+    return pick(u);
+}
+
+std::vector<std::size_t> AliasTable::sample(RandomEngine& eng, std::size_t n) const {
+    std::vector<double> u(n);
+    eng.fill_uniform(u.data(), n);
+
+    std::vector<std::size_t> res(n);
+    for (std::size_t i = 0; i < n; ++i) res[i] = pick(u[i]);
+    return res;
+}
+
+// BatchMeans
+
+void BatchMeans::add(double x) {
+    total.add(x);
+
+    cur_sum += x;
+    if (++cur_n < size) return;
+
+    batches.push_back(cur_sum / cur_n);
+    cur_sum = 0.;
+    cur_n = 0;
+
+    if (batches.size() == 2 * n_batches) {
+        for (std::size_t i = 0; i < n_batches; ++i) {
+            batches[i] = 0.5 * (batches[2 * i] + batches[2 * i + 1]);
+        }
+        batches.resize(n_batches);
+        size *= 2;
+    }
+}
+
+std::ostream& operator<<(std::ostream& out, const BatchMeans& bm) {
+    auto precision = out.precision(std::numeric_limits<double>::max_digits10);
+    out << bm.n_batches << ' ' << bm.size << ' ' << bm.cur_sum << ' ' << bm.cur_n << ' ' << bm.total << ' ' << bm.batches.size();
+    for (auto b : bm.batches) out << ' ' << b;
+    out.precision(precision);
+    return out;
+}
+
+std::istream& operator>>(std::istream& in, BatchMeans& bm) {
+    std::size_t n;
+    in >> bm.n_batches >> bm.size >> bm.cur_sum >> bm.cur_n >> bm.total >> n;
+    bm.batches.resize(n);
+    for (auto& b : bm.batches) in >> b;
+    return in;
+}
+
+double BatchMeans::sem() const {
+    if (batches.size() < 2) return std::numeric_limits<double>::infinity();
+
+    Welford w;
+    for (auto b : batches) w.add(b);
+    return std::sqrt(w.variance() / batches.size());
+}
+
+// StopRule
+
+bool StopRule::should_stop(std::size_t n_samples, double estimate, const Interval& ci) {
+    std::ostringstream reason;
+
+    if (max_samples && n_samples >= max_samples) {
+        reason << "max samples (" << n_samples << ")";
+    } else if (time_budget > 0 && elapsed() >= time_budget) {
+        reason << "time budget (" << elapsed() << " s)";
+    } else if (rel_ci > 0 && n_samples >= min_samples && estimate != 0 &&
+               ci.half_width() / std::abs(estimate) <= rel_ci) {
+        reason << "relative CI half-width " << ci.half_width() / std::abs(estimate) << " <= " << rel_ci;
+    } else {
+        return false;
+    }
+
+    stop_reason = reason.str();
+    return true;
+}
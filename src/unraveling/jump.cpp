@@ -1,6 +1,9 @@
 #include "unraveling/jump.h"
 
 #include <cmath>
+#include <algorithm>
+
+#include "unraveling/recorder.h"
 
 template<typename T> T pow2(T x) { return x * x; }
 
@@ -25,44 +28,146 @@ void Jump::derivative(State& dy, const State& y, double t) {
 }
 
 void Jump::solve(ODESolver* solver, State& psi, double t1, double t2) {
-    if (!n_lindblads()) {
+    if (!n_lindblads() && !obs_recorder && breakpoints.empty()) {
         solver->solve(this, psi, t1, t2);
         return;
     }
 
+    double target_norm2 = rnd(eng);
+
+    if (prefix_cache && !record_statistics && !obs_recorder) {
+        if (auto entry = prefix_cache->find(psi, H, t1, t2, prefix_tag)) {
+            if (!replay(*entry, solver, psi, t1, target_norm2)) {
+                psi = entry->final_psi;
+                return;
+            }
+            // Jumped at t1
+            target_norm2 = rnd(eng);
+
+        } else {
+            auto recorder = prefix_cache->start(psi, H, t1, t2, prefix_tag);
+            if (!evolve(solver, psi, t1, t2, target_norm2, &recorder)) recorder.commit(psi);
+            return;
+        }
+    }
+
+    evolve(solver, psi, t1, t2, target_norm2, nullptr);
+}
+
+bool Jump::evolve(ODESolver* solver, State& psi, double t1, double t2, double target_norm2, JumpPrefixCache::Recorder* recorder) {
     auto psi_prev_g = pool.allocate_similar(psi);
     State& psi_prev = psi_prev_g.state;
 
-    solver->init_one_step(this, psi, t1, t2);
-    double target_norm2 = rnd(eng);
+    // Statistics
+    std::vector<double> pops_prev, pops_now;
+    double t_pops = t1;
+    auto integrate_pops = [&]() {
+        populations(pops_now, psi, t1);
+        for (std::size_t k = 0; k < n_lindblads(); ++k) {
+            integrated_pops[k] += 0.5 * (t1 - t_pops) * (pops_prev[k] + pops_now[k]);
+        }
+        std::swap(pops_prev, pops_now);
+        t_pops = t1;
+    };
+    if (record_statistics) populations(pops_prev, psi, t1);
+
+    double t_crit = next_breakpoint(t1, t2);
+    solver->init_one_step(this, psi, t1, t_crit);
 
+    bool jumped = false;
     double norm2_prev = pow2(psi.norm());
     while (t1 < t2) {
         psi_prev = psi;
 
-        double h = solver->solve_one_step(this, psi, t1, t2);
+        double h = solver->solve_one_step(this, psi, t1, t_crit);
         double norm2_now = pow2(psi.norm());
         // std::cout << norm2_now << std::endl;
         t1 += h;
         // psi_prev (at time t1 - h, with norm2_prev) -> psi (at time t1, with norm2_now)
 
         if (norm2_now <= target_norm2) { // Jump
-            locate_jump_time(psi_prev, t1 - h, norm2_prev, psi, t1, norm2_now, target_norm2, solver);
+            // locate_jump_time moves t1 and psi_prev inside the step: the recorder sees the step from its start
+            double t_step = t1 - h;
+            if (obs_recorder && obs_recorder->wants(t_step, t1)) {
+                auto psi_step_g = pool.allocate_similar(psi);
+                State& psi_step = psi_step_g.state;
+                psi_step = psi_prev;
+                obs_recorder->mark(psi_step, t_step, pool);
+
+                locate_jump_time(psi_prev, t_step, norm2_prev, psi, t1, norm2_now, target_norm2, solver);
+                if (record_statistics) integrate_pops();
+                obs_recorder->on_step(psi_step, t_step, psi, t1, pool);
+            } else {
+                locate_jump_time(psi_prev, t_step, norm2_prev, psi, t1, norm2_now, target_norm2, solver);
+                if (record_statistics) integrate_pops();
+            }
             // Now, we have psi at time t1 with target_norm2 waiting to jump
 
             // std::cout << "jump" << std::endl;
             jump(psi, t1);
+            if (obs_recorder) obs_recorder->discontinuity();
             norm2_now = 1.;
+            jumped = true;
+            recorder = nullptr; // Not a no-jump evolution any more
+            if (record_statistics) populations(pops_prev, psi, t1);
             
             // Re-init
-            solver->init_one_step(this, psi, t1, t2);
+            t_crit = next_breakpoint(t1, t2);
+            solver->init_one_step(this, psi, t1, t_crit);
             target_norm2 = rnd(eng);
+
+        } else {
+            if (record_statistics) integrate_pops();
+            if (recorder) recorder->record(t1, norm2_now, psi);
+            if (obs_recorder) obs_recorder->on_step(psi_prev, t1 - h, psi, t1, pool);
         }
 
         norm2_prev = norm2_now;
+
+        // At a breakpoint (the solver returns exactly there, t1 is the sum of the steps): on to the next one
+        if (t_crit < t2 && t_crit - t1 <= 1e-12 * t2) {
+            t1 = t_crit;
+            t_crit = next_breakpoint(t1, t2);
+            solver->set_critical_time(t_crit);
+        }
     }
 
     psi.normalize();
+    return jumped;
+}
+
+double Jump::next_breakpoint(double t, double t2) const {
+    auto it = std::upper_bound(breakpoints.begin(), breakpoints.end(), t);
+    return (it != breakpoints.end() && *it < t2) ? *it : t2;
+}
+
+bool Jump::replay(const JumpPrefixCache::Entry& entry, ODESolver* solver, State& psi, double& t, double target_norm2) {
+    // First step ending below the target
+    const auto& curve = entry.curve;
+    std::size_t i = 1;
+    while (i < curve.size() && curve[i].norm2 > target_norm2) ++i;
+    if (i == curve.size()) return false;
+
+    const auto& prev = curve[i - 1];
+    const auto& next = curve[i];
+
+    // Back to the beginning of the step from the nearest checkpoint
+    auto psi_prev_g = pool.allocate_similar(psi);
+    State& psi_prev = psi_prev_g.state;
+
+    const auto& c = entry.checkpoint_before(prev.t);
+    psi_prev = c.psi;
+    if (prev.t > c.t) solver->solve(this, psi_prev, c.t, prev.t);
+    double norm2_prev = pow2(psi_prev.norm());
+
+    // The first guess of locate_jump_time interpolates the cached curve
+    psi = psi_prev;
+    if (next.t - prev.t < norm_time_atol) solver->solve(this, psi, prev.t, next.t);
+    t = next.t;
+    locate_jump_time(psi_prev, prev.t, norm2_prev, psi, t, next.norm2, target_norm2, solver);
+
+    jump(psi, t);
+    return true;
 }
 
 void Jump::locate_jump_time(State& psi_prev, double t_prev, double norm2_prev, State& psi, double& t, double norm2_now, double target_norm2, ODESolver* solver) {
@@ -127,6 +232,7 @@ void Jump::jump(State& psi, double t) {
     psi.normalize();
 
     // Record
+    ++n_jumps[i];
     jump_info.push_back(JumpInfo{
         .time = t,
         .idx = i,
@@ -134,6 +240,29 @@ void Jump::jump(State& psi, double t) {
 }
 
 
+void Jump::populations(std::vector<double>& pops, const State& psi, double t) {
+    auto tmp_g = pool.allocate_similar(psi);
+    State& tmp = tmp_g.state;
+
+    double norm2 = pow2(psi.norm());
+    pops.resize(n_lindblads());
+    for (std::size_t k = 0; k < n_lindblads(); ++k) {
+        L[k]->apply(tmp, psi, t); // tmp = L |psi>
+        pops[k] = pow2(tmp.norm()) / norm2;
+    }
+}
+
+double Jump::log_likelihood_ratio(const std::vector<double>& scales) const {
+    Assert(scales.size() == n_lindblads());
+
+    double log_w = 0.;
+    for (std::size_t k = 0; k < n_lindblads(); ++k) {
+        Assert(scales[k] > 0);
+        log_w += n_jumps[k] * std::log(scales[k]) - (scales[k] - 1.) * integrated_pops[k];
+    }
+    return log_w;
+}
+
 // JumpOpt
 
 void JumpOpt::derivative(State& dy, const State& y, double t) {
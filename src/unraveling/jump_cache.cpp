@@ -0,0 +1,116 @@
+#include "unraveling/jump_cache.h"
+
+#include <cstring>
+
+// FNV-1a
+static std::uint64_t hash_bytes(std::uint64_t h, const void* data, std::size_t n) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    for (std::size_t i = 0; i < n; ++i) {
+        h ^= p[i];
+        h *= 0x100000001b3ull;
+    }
+    return h;
+}
+
+static bool same_state(const State& a, const State& b) {
+    return a.total_dims() == b.total_dims() &&
+           std::memcmp(a.data(), b.data(), a.total_dims() * sizeof(Complex)) == 0;
+}
+
+std::uint64_t JumpPrefixCache::fingerprint(const State& psi) {
+    return hash_bytes(0xcbf29ce484222325ull, psi.data(), psi.total_dims() * sizeof(Complex));
+}
+
+std::uint64_t JumpPrefixCache::make_key(const State& psi, const Op* H, double t1, double t2, std::uint64_t tag) {
+    std::uint64_t h = fingerprint(psi);
+    h = hash_bytes(h, &H, sizeof(H));
+    h = hash_bytes(h, &t1, sizeof(t1));
+    h = hash_bytes(h, &t2, sizeof(t2));
+    h = hash_bytes(h, &tag, sizeof(tag));
+    return h;
+}
+
+const JumpPrefixCache::Checkpoint& JumpPrefixCache::Entry::checkpoint_before(double t) const {
+    std::size_t i = checkpoints.size();
+    while (--i > 0 && checkpoints[i].t > t) {}
+    return checkpoints[i];
+}
+
+const JumpPrefixCache::Entry* JumpPrefixCache::find(const State& psi, const Op* H, double t1, double t2, std::uint64_t tag) {
+    auto it = entries.find(make_key(psi, H, t1, t2, tag));
+
+    // The fingerprint is only a hash, check everything
+    if (it == entries.end() ||
+        it->second.H != H || it->second.t1 != t1 || it->second.t2 != t2 || it->second.tag != tag ||
+        !same_state(it->second.checkpoints[0].psi, psi)) {
+        ++misses;
+        return nullptr;
+    }
+
+    ++hits;
+    return &it->second;
+}
+
+JumpPrefixCache::Recorder JumpPrefixCache::start(const State& psi, const Op* H, double t1, double t2, std::uint64_t tag) {
+    return Recorder(*this, make_key(psi, H, t1, t2, tag), psi, H, t1, t2, tag);
+}
+
+void JumpPrefixCache::insert(std::uint64_t key, Entry entry) {
+    if (entries.count(key)) return;
+
+    std::size_t bytes = entry_bytes(entry);
+    if (bytes > max_bytes) return;
+
+    while ((entries.size() >= max_entries || n_bytes + bytes > max_bytes) && !order.empty()) {
+        auto it = entries.find(order.front());
+        n_bytes -= entry_bytes(it->second);
+        entries.erase(it);
+        order.pop_front();
+    }
+
+    entries.emplace(key, std::move(entry));
+    order.push_back(key);
+    n_bytes += bytes;
+}
+
+std::size_t JumpPrefixCache::entry_bytes(const Entry& entry) {
+    std::size_t n_states = entry.checkpoints.size() + 1; // And final_psi
+    return n_states * entry.final_psi.total_dims() * sizeof(Complex) + entry.curve.size() * sizeof(Point);
+}
+
+// Recorder
+
+JumpPrefixCache::Recorder::Recorder(JumpPrefixCache& cache, std::uint64_t key, const State& psi, const Op* H, double t1, double t2, std::uint64_t tag)
+    : cache(cache), key(key) {
+    entry.H = H;
+    entry.t1 = t1;
+    entry.t2 = t2;
+    entry.tag = tag;
+
+    double norm = psi.norm();
+    double norm2 = norm * norm;
+    entry.curve.push_back(Point{t1, norm2});
+    entry.checkpoints.push_back(Checkpoint{t1, norm2, State{psi}});
+}
+
+void JumpPrefixCache::Recorder::record(double t, double norm2, const State& psi) {
+    entry.curve.push_back(Point{t, norm2});
+
+    if (++n_steps % stride) return;
+    entry.checkpoints.push_back(Checkpoint{t, norm2, State{psi}});
+
+    // Too many, keep every other one (checkpoints[0] included)
+    if (entry.checkpoints.size() > cache.max_checkpoints) {
+        std::size_t n = 1;
+        for (std::size_t i = 2; i < entry.checkpoints.size(); i += 2) {
+            entry.checkpoints[n++] = std::move(entry.checkpoints[i]);
+        }
+        entry.checkpoints.erase(entry.checkpoints.begin() + n, entry.checkpoints.end());
+        stride *= 2;
+    }
+}
+
+void JumpPrefixCache::Recorder::commit(const State& final_psi) {
+    entry.final_psi = State{final_psi};
+    cache.insert(key, std::move(entry));
+}
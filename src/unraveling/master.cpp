@@ -0,0 +1,117 @@
+#include "unraveling/master.h"
+
+#include <algorithm>
+#include <cmath>
+
+void MasterEquation::derivative(State& drho, const State& rho, double t) {
+    H->apply(drho, rho, t); // drho = -i H rho
+    drho *= _MI;
+
+    auto tmp1_g = pool.allocate_similar(rho);
+    State& tmp1 = tmp1_g.state;
+
+    auto tmp2_g = pool.allocate_similar(rho);
+    State& tmp2 = tmp2_g.state;
+
+    if (n_lindblads()) {
+        auto jumps_g = pool.allocate_similar(rho);
+        State& jumps = jumps_g.state;
+        jumps = 0;
+
+        for (std::size_t i = 0; i < n_lindblads(); ++i) {
+            L[i]->apply(tmp1, rho, t); // tmp1 = L rho
+
+            Ldag[i]->apply(tmp2, tmp1, t); // tmp2 = L^ L rho
+            drho.axpy(-0.5, tmp2); // drho += -1/2 L^ L rho
+
+            dagger(tmp2, tmp1); // tmp2 = rho L^
+            L[i]->apply(tmp1, tmp2, t); // tmp1 = L rho L^
+            jumps += tmp1;
+        }
+
+        dagger(tmp2, drho); // tmp2 = (K rho)^
+        drho += tmp2;
+        drho += jumps;
+    } else {
+        dagger(tmp2, drho);
+        drho += tmp2;
+    }
+}
+
+State MasterEquation::density_matrix(const State& psi) {
+    std::vector<sz_t> dims;
+    for (sz_t i = 0; i < psi.n_freedoms(); ++i) dims.push_back(psi.dim(i));
+    dims.insert(dims.end(), dims.begin(), dims.end());
+
+    State rho{dims};
+    sz_t D = psi.total_dims();
+    for (sz_t r = 0; r < D; ++r) {
+        for (sz_t c = 0; c < D; ++c) {
+            rho[r * D + c] = psi[r] * std::conj(psi[c]);
+        }
+    }
+
+    return rho;
+}
+
+// rho is D x D, only the size is used as pooled states may carry other dims
+static sz_t side(const State& rho) {
+    sz_t D = std::llround(std::sqrt((double)rho.total_dims()));
+    Assert(D * D == rho.total_dims());
+    return D;
+}
+
+Complex MasterEquation::trace(const State& rho) {
+    sz_t D = side(rho);
+
+    Complex tr = 0;
+    for (sz_t r = 0; r < D; ++r) tr += rho[r * D + r];
+    return tr;
+}
+
+void MasterEquation::dagger(State& out, const State& rho) {
+    sz_t D = side(rho);
+    Assert(out.total_dims() == rho.total_dims() && out.data() != rho.data());
+
+    // Blocked to keep both sides in cache
+    const sz_t B = 32;
+    for (sz_t r0 = 0; r0 < D; r0 += B) {
+        sz_t r1 = std::min(r0 + B, D);
+        for (sz_t c0 = 0; c0 < D; c0 += B) {
+            sz_t c1 = std::min(c0 + B, D);
+            for (sz_t r = r0; r < r1; ++r) {
+                for (sz_t c = c0; c < c1; ++c) {
+                    out[c * D + r] = std::conj(rho[r * D + c]);
+                }
+            }
+        }
+    }
+    out.mark_all_blocks();
+}
+
+void MasterEquation::renormalize(State& rho) {
+    sz_t D = side(rho);
+
+    for (sz_t r = 0; r < D; ++r) {
+        rho[r * D + r] = rho[r * D + r].real();
+        for (sz_t c = r + 1; c < D; ++c) {
+            Complex x = 0.5 * (rho[r * D + c] + std::conj(rho[c * D + r]));
+            rho[r * D + c] = x;
+            rho[c * D + r] = std::conj(x);
+        }
+    }
+
+    rho.mark_all_blocks();
+
+    double tr = trace(rho).real();
+    Assert(tr > 0);
+    rho *= 1. / tr;
+}
+
+Complex MasterEquation::expectation(Op* A, const State& rho, double t) {
+    auto tmp_g = pool.allocate_similar(rho);
+    State& tmp = tmp_g.state;
+
+    A->apply(tmp, rho, t); // tmp = A rho
+    return trace(tmp);
+}
@@ -2,6 +2,8 @@
 
 #include <chrono>
 
+#include "unraveling/recorder.h"
+
 void QSD::derivative(State& dpsi, const State& psi, double t) {
     H->apply(dpsi, psi, t); // dpsi = -i H(t) |psi>
     dpsi *= _MI;
@@ -52,12 +54,23 @@ bool QSD::apply_stochastic(State& y_t_h, const State& y, double t, double h) {
     return true;
 }
 
+void QSD::diffusion(State& dpsi, const State& psi, double t, std::size_t k) {
+    L[k]->apply(dpsi, psi, t); // dpsi = L |psi>
+    Complex e = psi.inner(dpsi); // e = <L> = <psi| L |psi>
+    dpsi.axpy(-e, psi); // dpsi += -<L> |psi>
+}
+
 void QSD::solve(ODESolver* solver, State& psi1, double t1, double t2) {
     if (!n_lindblads()) {
         solver->solve(this, psi1, t1, t2);
         return;
     }
 
+    if (sde_solver) {
+        sde_solver->solve(this, psi1, t1, t2);
+        return;
+    }
+
     auto psi_last_g = pool.allocate_similar(psi1);
     State& psi_last = psi_last_g.state;
 
@@ -70,6 +83,7 @@ void QSD::solve(ODESolver* solver, State& psi1, double t1, double t2) {
         solver->solve(this, psi1, t1, t1 + h_stoch);
         // stochastic
         apply_stochastic(psi1, psi_last, t1, h_stoch);
+        if (obs_recorder) obs_recorder->on_step(psi_last, t1, psi1, t1 + h_stoch, pool);
         t1 += h_stoch;
     }
 }
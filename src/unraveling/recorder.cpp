@@ -0,0 +1,227 @@
+#include "unraveling/recorder.h"
+
+#include <cmath>
+
+#include "base/assertion.h"
+
+ObservableRecorder::~ObservableRecorder() {
+    flush();
+    {
+        std::lock_guard<std::mutex> lock{m};
+        stopping = true;
+    }
+    cv.notify_all();
+    if (flusher.joinable()) flusher.join();
+}
+
+// Observables
+
+void ObservableRecorder::add_op(std::string name, Op* op) {
+    Observable o;
+    o.op = op;
+    obs.push_back(std::move(o));
+    obs_names.push_back(std::move(name));
+}
+
+void ObservableRecorder::add_pauli(std::string name, const std::string& pauli) {
+    Observable o;
+    o.pauli.reset(new PauliString(pauli));
+    paulis.push_back(o.pauli.get());
+    pauli_obs.push_back(obs.size());
+    obs.push_back(std::move(o));
+    obs_names.push_back(std::move(name));
+}
+
+void ObservableRecorder::add_projector(std::string name, std::vector<sz_t> frees, sz_t outcome) {
+    Observable o;
+    o.frees = std::move(frees);
+    o.outcome = outcome;
+    obs.push_back(std::move(o));
+    obs_names.push_back(std::move(name));
+}
+
+void ObservableRecorder::evaluate(std::vector<double>& values, const State& psi, double t, StatePool& pool) {
+    values.resize(obs.size());
+
+    double norm2 = 0.;
+    for (std::size_t k = 0; k < obs.size(); ++k) {
+        auto& o = obs[k];
+        if (o.op) {
+            if (norm2 == 0.) norm2 = std::pow(psi.norm(), 2);
+
+            auto tmp_g = pool.allocate_similar(psi);
+            State& tmp = tmp_g.state;
+            o.op->apply(tmp, psi, t);
+            values[k] = psi.inner(tmp).real() / norm2;
+
+        } else if (!o.pauli) {
+            values[k] = psi.marginal(o.frees)[o.outcome];
+        }
+    }
+
+    if (!paulis.empty()) {
+        PauliString::expectations(pauli_values, psi, paulis);
+        for (std::size_t j = 0; j < paulis.size(); ++j) values[pauli_obs[j]] = pauli_values[j];
+    }
+}
+
+// Steps
+
+void ObservableRecorder::begin_trajectory(std::uint64_t traj) {
+    this->traj = traj;
+    cursor = 0;
+    offset = 0.;
+    last_valid = false;
+}
+
+bool ObservableRecorder::wants(double t_prev, double t) const {
+    if (times.empty()) return true;
+
+    std::size_t i = cursor;
+    while (i < times.size() && times[i] < t_prev + offset) ++i;
+    return i < times.size() && times[i] <= t + offset;
+}
+
+void ObservableRecorder::mark(const State& psi_prev, double t_prev, StatePool& pool) {
+    if (last_valid && last_t == t_prev) return;
+
+    evaluate(last_values, psi_prev, t_prev, pool);
+    last_t = t_prev;
+    last_valid = true;
+}
+
+void ObservableRecorder::on_step(const State& psi_prev, double t_prev, const State& psi, double t, StatePool& pool) {
+    // Every step
+    if (times.empty()) {
+        evaluate(cur_values, psi, t, pool);
+        push_row(t + offset, cur_values, cur_values, 0.);
+        std::swap(last_values, cur_values);
+        last_t = t;
+        last_valid = true;
+        return;
+    }
+
+    // Times not covered by any step (e.g. before the first solve) are dropped
+    while (cursor < times.size() && times[cursor] < t_prev + offset) ++cursor;
+    if (cursor == times.size() || times[cursor] > t + offset) {
+        last_valid = false;
+        return;
+    }
+
+    if (!last_valid || last_t != t_prev) evaluate(last_values, psi_prev, t_prev, pool);
+    evaluate(cur_values, psi, t, pool);
+
+    for (; cursor < times.size() && times[cursor] <= t + offset; ++cursor) {
+        double w = (t > t_prev) ? (times[cursor] - offset - t_prev) / (t - t_prev) : 1.;
+        push_row(times[cursor], last_values, cur_values, w);
+    }
+
+    std::swap(last_values, cur_values);
+    last_t = t;
+    last_valid = true;
+}
+
+void ObservableRecorder::push_row(double t, const std::vector<double>& a, const std::vector<double>& b, double w) {
+    if (buffer.values.size() != obs.size()) {
+        Assert(buffer.size() == 0); // No observables added while recording
+        buffer = new_columns();
+    }
+
+    buffer.t.push_back(t);
+    buffer.traj.push_back(traj);
+    for (std::size_t k = 0; k < obs.size(); ++k) buffer.values[k].push_back((1. - w) * a[k] + w * b[k]);
+
+    if (buffer.size() >= capacity) flush();
+}
+
+// Buffers
+
+ObservableRecorder::Columns ObservableRecorder::new_columns() const {
+    Columns c;
+    c.t.reserve(capacity);
+    c.traj.reserve(capacity);
+    c.values.resize(obs.size());
+    for (auto& v : c.values) v.reserve(capacity);
+    return c;
+}
+
+void ObservableRecorder::flush() {
+    if (buffer.size() == 0) return;
+
+    if (!sink) {
+        if (kept.values.size() != buffer.values.size()) kept.values.resize(buffer.values.size());
+        kept.t.insert(kept.t.end(), buffer.t.begin(), buffer.t.end());
+        kept.traj.insert(kept.traj.end(), buffer.traj.begin(), buffer.traj.end());
+        for (std::size_t k = 0; k < buffer.values.size(); ++k) {
+            kept.values[k].insert(kept.values[k].end(), buffer.values[k].begin(), buffer.values[k].end());
+        }
+        buffer.clear();
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock{m};
+        full.push_back(std::move(buffer));
+        if (!spare.empty()) {
+            buffer = std::move(spare.back());
+            spare.pop_back();
+        } else {
+            buffer = new_columns();
+        }
+
+        if (!flusher.joinable()) flusher = std::thread(&ObservableRecorder::flush_loop, this);
+    }
+    cv.notify_all();
+}
+
+void ObservableRecorder::wait() {
+    flush();
+
+    std::unique_lock<std::mutex> lock{m};
+    cv.wait(lock, [this]() { return full.empty() && !busy; });
+}
+
+void ObservableRecorder::flush_loop() {
+    std::unique_lock<std::mutex> lock{m};
+    while (true) {
+        cv.wait(lock, [this]() { return stopping || !full.empty(); });
+        if (full.empty()) break; // Stopping and nothing left
+
+        Columns rows = std::move(full.front());
+        full.pop_front();
+        busy = true;
+
+        lock.unlock();
+        sink(obs_names, rows);
+        rows.clear();
+        lock.lock();
+
+        busy = false;
+        if (rows.values.size() == obs.size()) spare.push_back(std::move(rows));
+        cv.notify_all();
+    }
+}
+
+ObservableRecorder::Sink ObservableRecorder::csv_sink(std::ostream& out) {
+    // Shared by the recorders it is given to
+    auto header = std::make_shared<bool>(false);
+    auto out_m = std::make_shared<std::mutex>();
+
+    return [&out, header, out_m](const std::vector<std::string>& names, const Columns& rows) {
+        std::lock_guard<std::mutex> lock{*out_m};
+
+        if (!*header) {
+            out << "t,traj";
+            for (auto& name : names) out << "," << name;
+            out << "\n";
+            *header = true;
+        }
+
+        for (std::size_t i = 0; i < rows.size(); ++i) {
+            out << rows.t[i] << "," << rows.traj[i];
+            for (auto& v : rows.values) out << "," << v[i];
+            out << "\n";
+        }
+        out.flush();
+    };
+}